@@ -3,271 +3,7065 @@
 #include <string>
 #include <cctype>
 #include <limits> // Required for numeric_limits
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <functional>
+#include <utility>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <unordered_map>
+#include <unordered_set>
+#include <string_view>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <charconv>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 using namespace std;
 
-class Employee {
-protected:
-    string id;
-    string name;
-    double salary;
+// Allocation accounting: every global operator new/delete is tagged with the
+// category active on the calling thread, so hot paths can be checked for heap traffic.
+enum class AllocCategory { General, Input, Employee, Index, Report, Count };
 
-public:
-    Employee(string id, string name, double salary)
-        : id(id), name(name), salary(salary) {}
+const char* allocCategoryName(AllocCategory category) {
+    switch(category) {
+        case AllocCategory::General: return "General";
+        case AllocCategory::Input: return "Input";
+        case AllocCategory::Employee: return "Employee";
+        case AllocCategory::Index: return "Index";
+        case AllocCategory::Report: return "Report";
+        default: return "Unknown";
+    }
+}
 
-    virtual void display() const = 0;
-    virtual ~Employee() {}
-    string getId() const { return id; }
+struct AllocCounters {
+    size_t allocations;
+    size_t frees;
+    size_t bytes;
 };
 
-class FullTimeEmployee : public Employee {
+class AllocTracker {
+    static const size_t categoryCount = static_cast<size_t>(AllocCategory::Count);
+    static atomic<size_t> allocations[categoryCount];
+    static atomic<size_t> frees[categoryCount];
+    static atomic<size_t> bytes[categoryCount];
+    static thread_local AllocCategory current;
+    // Off unless --alloc-check asks for it: the shared counters would make
+    // every allocation on every thread contend for the same cache lines.
+    static bool counting;
+
 public:
-    FullTimeEmployee(string id, string name, double salary)
-        : Employee(id, name, salary) {}
+    // Header stored in front of every block; keeps malloc's 16-byte alignment.
+    static constexpr size_t headerSize = 16;
 
-    void display() const {
-        cout << "Employee: " << name << " (ID: " << id << ")\n";
-        cout << "Fixed Monthly Salary: $" << salary << "\n\n";
+    static AllocCategory category() { return current; }
+    static void setCategory(AllocCategory category) { current = category; }
+
+    // Call before starting other threads.
+    static void startCounting() { counting = true; }
+
+    static void recordAllocation(AllocCategory category, size_t size) {
+        if(!counting) return;
+        size_t index = static_cast<size_t>(category);
+        allocations[index].fetch_add(1, memory_order_relaxed);
+        bytes[index].fetch_add(size, memory_order_relaxed);
+    }
+
+    static void recordFree(AllocCategory category) {
+        if(!counting) return;
+        frees[static_cast<size_t>(category)].fetch_add(1, memory_order_relaxed);
+    }
+
+    static AllocCounters counters(AllocCategory category) {
+        size_t index = static_cast<size_t>(category);
+        return { allocations[index].load(memory_order_relaxed),
+                 frees[index].load(memory_order_relaxed),
+                 bytes[index].load(memory_order_relaxed) };
+    }
+
+    static size_t totalAllocations() {
+        size_t total = 0;
+        for(size_t i = 0; i < categoryCount; i++) {
+            total += allocations[i].load(memory_order_relaxed);
+        }
+        return total;
+    }
+
+    static void printStats() {
+        cout << "Allocation Statistics ---\n";
+        for(size_t i = 0; i < categoryCount; i++) {
+            AllocCounters c = counters(static_cast<AllocCategory>(i));
+            cout << allocCategoryName(static_cast<AllocCategory>(i)) << ": "
+                 << c.allocations << " allocations, " << c.frees << " frees, "
+                 << c.bytes << " bytes\n";
+        }
+        cout << "\n";
     }
 };
 
-class PartTimeEmployee : public Employee {
-    double hourlyRate;
-    int hoursWorked;
+atomic<size_t> AllocTracker::allocations[AllocTracker::categoryCount];
+atomic<size_t> AllocTracker::frees[AllocTracker::categoryCount];
+atomic<size_t> AllocTracker::bytes[AllocTracker::categoryCount];
+thread_local AllocCategory AllocTracker::current = AllocCategory::General;
+bool AllocTracker::counting = false;
 
-public:
-    PartTimeEmployee(string id, string name, double hourlyRate, int hoursWorked)
-        : Employee(id, name, hourlyRate * hoursWorked),
-          hourlyRate(hourlyRate), hoursWorked(hoursWorked) {}
+// Tags allocations made in the enclosing scope with a category.
+class AllocScope {
+    AllocCategory previous;
 
-    void display() const {
-        cout << "Employee: " << name << " (ID: " << id << ")\n";
-        cout << "Hourly Rate: $" << hourlyRate << "\n";
-        cout << "Hours Worked: " << hoursWorked << "\n";
-        cout << "Total Salary: $" << salary << "\n\n";
+public:
+    explicit AllocScope(AllocCategory category) : previous(AllocTracker::category()) {
+        AllocTracker::setCategory(category);
     }
+    ~AllocScope() { AllocTracker::setCategory(previous); }
+
+    AllocScope(const AllocScope&) = delete;
+    AllocScope& operator=(const AllocScope&) = delete;
 };
 
-class ContractualEmployee : public Employee {
-    double paymentPerProject;
-    int projectsCompleted;
+// Kept out of line so the compiler never pairs the raw malloc/free with new/delete.
+#if defined(__GNUC__)
+#define NOINLINE __attribute__((noinline))
+#else
+#define NOINLINE
+#endif
+
+NOINLINE void* trackedAlloc(size_t size) {
+    AllocCategory category = AllocTracker::category();
+    void* block = malloc(size + AllocTracker::headerSize);
+    if(!block) return nullptr;
+    *static_cast<AllocCategory*>(block) = category;
+    AllocTracker::recordAllocation(category, size);
+    return static_cast<char*>(block) + AllocTracker::headerSize;
+}
+
+NOINLINE void trackedFree(void* ptr) {
+    if(!ptr) return;
+    void* block = static_cast<char*>(ptr) - AllocTracker::headerSize;
+    AllocTracker::recordFree(*static_cast<AllocCategory*>(block));
+    free(block);
+}
+
+// Over-aligned blocks put the header at the end of a full alignment unit,
+// so the caller's pointer keeps its alignment.
+NOINLINE void* trackedAlignedAlloc(size_t size, align_val_t alignment) {
+    size_t pad = max(static_cast<size_t>(alignment), AllocTracker::headerSize);
+    AllocCategory category = AllocTracker::category();
+    void* block = nullptr;
+    if(posix_memalign(&block, pad, size + pad) != 0) return nullptr;
+    char* ptr = static_cast<char*>(block) + pad;
+    *reinterpret_cast<AllocCategory*>(ptr - AllocTracker::headerSize) = category;
+    AllocTracker::recordAllocation(category, size);
+    return ptr;
+}
+
+NOINLINE void trackedAlignedFree(void* ptr, align_val_t alignment) {
+    if(!ptr) return;
+    size_t pad = max(static_cast<size_t>(alignment), AllocTracker::headerSize);
+    AllocTracker::recordFree(*reinterpret_cast<AllocCategory*>(static_cast<char*>(ptr) - AllocTracker::headerSize));
+    free(static_cast<char*>(ptr) - pad);
+}
+
+void* operator new(size_t size) {
+    void* ptr = trackedAlloc(size);
+    if(!ptr) throw bad_alloc();
+    return ptr;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, const nothrow_t&) noexcept { return trackedAlloc(size); }
+void* operator new[](size_t size, const nothrow_t&) noexcept { return trackedAlloc(size); }
+void operator delete(void* ptr) noexcept { trackedFree(ptr); }
+void operator delete[](void* ptr) noexcept { trackedFree(ptr); }
+void operator delete(void* ptr, size_t) noexcept { trackedFree(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { trackedFree(ptr); }
+void operator delete(void* ptr, const nothrow_t&) noexcept { trackedFree(ptr); }
+void operator delete[](void* ptr, const nothrow_t&) noexcept { trackedFree(ptr); }
+void* operator new(size_t size, align_val_t alignment) {
+    void* ptr = trackedAlignedAlloc(size, alignment);
+    if(!ptr) throw bad_alloc();
+    return ptr;
+}
+void* operator new[](size_t size, align_val_t alignment) { return operator new(size, alignment); }
+void* operator new(size_t size, align_val_t alignment, const nothrow_t&) noexcept { return trackedAlignedAlloc(size, alignment); }
+void* operator new[](size_t size, align_val_t alignment, const nothrow_t&) noexcept { return trackedAlignedAlloc(size, alignment); }
+void operator delete(void* ptr, align_val_t alignment) noexcept { trackedAlignedFree(ptr, alignment); }
+void operator delete[](void* ptr, align_val_t alignment) noexcept { trackedAlignedFree(ptr, alignment); }
+void operator delete(void* ptr, size_t, align_val_t alignment) noexcept { trackedAlignedFree(ptr, alignment); }
+void operator delete[](void* ptr, size_t, align_val_t alignment) noexcept { trackedAlignedFree(ptr, alignment); }
+void operator delete(void* ptr, align_val_t alignment, const nothrow_t&) noexcept { trackedAlignedFree(ptr, alignment); }
+void operator delete[](void* ptr, align_val_t alignment, const nothrow_t&) noexcept { trackedAlignedFree(ptr, alignment); }
+
+// Formatting helpers that append to a caller-owned buffer (no temporaries).
+void appendNumber(string& out, double value) {
+    char buffer[32];
+    int length = snprintf(buffer, sizeof(buffer), "%g", value);
+    out.append(buffer, length);
+}
 
+void appendNumber(string& out, int value) {
+    char buffer[16];
+    int length = snprintf(buffer, sizeof(buffer), "%d", value);
+    out.append(buffer, length);
+}
+
+// Work-stealing task scheduler shared by the application's bulk operations.
+// Each worker owns a deque: it pushes and pops its own tasks at the back and
+// steals from the front of the others when it runs dry. Threads waiting on a
+// parallelFor run queued tasks instead of blocking, so nested use is safe.
+class TaskScheduler {
 public:
-    ContractualEmployee(string id, string name, double paymentPerProject, int projectsCompleted)
-        : Employee(id, name, paymentPerProject * projectsCompleted),
-          paymentPerProject(paymentPerProject), projectsCompleted(projectsCompleted) {}
+    struct WorkerStats {
+        size_t executed;
+        size_t steals;
+        size_t stealAttempts;
+        size_t depth;
+        size_t maxDepth;
+    };
 
-    void display() const {
-        cout << "Employee: " << name << " (ID: " << id << ")\n";
-        cout << "Contract Payment Per Project: $" << paymentPerProject << "\n";
-        cout << "Projects Completed: " << projectsCompleted << "\n";
-        cout << "Total Salary: $" << salary << "\n\n";
+private:
+    struct Worker {
+        mutex lock;
+        deque<function<void()>> tasks;
+        size_t maxDepth = 0;
+        atomic<size_t> executed{0};
+        atomic<size_t> steals{0};
+        atomic<size_t> stealAttempts{0};
+        thread runner;
+    };
+
+    vector<unique_ptr<Worker>> workers;
+    mutex sleepLock;
+    condition_variable wake;
+    atomic<size_t> queued{0};
+    atomic<size_t> nextQueue{0};
+    atomic<size_t> externalSteals{0};
+    bool stopping = false;
+
+    // Index of the calling thread's worker in this scheduler, or npos.
+    static constexpr size_t npos = ~size_t(0);
+    size_t currentWorker() const {
+        return currentScheduler() == this ? currentIndex() : npos;
     }
-};
 
-class PayrollSystem {
-    vector<Employee*> employees;
+    static const TaskScheduler*& currentScheduler() {
+        static thread_local const TaskScheduler* scheduler = nullptr;
+        return scheduler;
+    }
 
-    bool isIdUnique(const string& id) const {
-        for(const auto& emp : employees) {
-            if(emp->getId() == id) return false;
+    static size_t& currentIndex() {
+        static thread_local size_t index = npos;
+        return index;
+    }
+
+    bool popLocal(size_t index, function<void()>& task) {
+        Worker& worker = *workers[index];
+        lock_guard<mutex> guard(worker.lock);
+        if(worker.tasks.empty()) return false;
+        task = std::move(worker.tasks.back());
+        worker.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(size_t thief, function<void()>& task) {
+        size_t count = workers.size();
+        size_t start = thief == npos ? nextQueue.load(memory_order_relaxed) : thief + 1;
+        for(size_t i = 0; i < count; i++) {
+            size_t victim = (start + i) % count;
+            if(victim == thief) continue;
+            Worker& worker = *workers[victim];
+            if(thief != npos) workers[thief]->stealAttempts.fetch_add(1, memory_order_relaxed);
+            lock_guard<mutex> guard(worker.lock);
+            if(worker.tasks.empty()) continue;
+            task = std::move(worker.tasks.front());
+            worker.tasks.pop_front();
+            if(thief != npos) workers[thief]->steals.fetch_add(1, memory_order_relaxed);
+            else externalSteals.fetch_add(1, memory_order_relaxed);
+            return true;
         }
+        return false;
+    }
+
+    bool take(size_t index, function<void()>& task) {
+        if((index != npos && popLocal(index, task)) || steal(index, task)) {
+            queued.fetch_sub(1, memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    // Runs one queued task on the calling thread; false if none was found.
+    bool runOne() {
+        size_t index = currentWorker();
+        function<void()> task;
+        if(!take(index, task)) return false;
+        task();
+        if(index != npos) workers[index]->executed.fetch_add(1, memory_order_relaxed);
         return true;
     }
 
-    string getValidID() {
-        string input;
-        bool isValidInput = false;
-        while (!isValidInput) {
-            cout << "Enter ID: ";
-            getline(cin, input);
-            input = trim(input);
+    void workerLoop(size_t index) {
+        currentScheduler() = this;
+        currentIndex() = index;
+        for(;;) {
+            if(runOne()) continue;
+            unique_lock<mutex> guard(sleepLock);
+            wake.wait(guard, [this]() { return stopping || queued.load() > 0; });
+            if(stopping && queued.load() == 0) return;
+        }
+    }
 
-            bool valid = !input.empty();
-            for(char c : input) {
-                if(!isalnum(c)) {
-                    valid = false;
-                    break;
-                }
+public:
+    // workerCount 0 means one worker per hardware thread. pinWorkers binds
+    // worker i to CPU i (modulo the CPU count) where the platform allows it.
+    explicit TaskScheduler(size_t workerCount = 0, bool pinWorkers = false) {
+        size_t cpus = max<unsigned>(thread::hardware_concurrency(), 1);
+        if(workerCount == 0) workerCount = cpus;
+        for(size_t i = 0; i < workerCount; i++) workers.push_back(make_unique<Worker>());
+        for(size_t i = 0; i < workerCount; i++) {
+            workers[i]->runner = thread(&TaskScheduler::workerLoop, this, i);
+#ifdef __linux__
+            if(pinWorkers) {
+                cpu_set_t cpuSet;
+                CPU_ZERO(&cpuSet);
+                CPU_SET(i % cpus, &cpuSet);
+                pthread_setaffinity_np(workers[i]->runner.native_handle(), sizeof(cpuSet), &cpuSet);
             }
+#else
+            (void)pinWorkers;
+#endif
+        }
+    }
 
-            if(valid) {
-                if(isIdUnique(input)) {
-                    isValidInput = true;
-                } else {
-                    cout << "Duplicate ID! Try again.\n";
-                }
-            } else {
-                cout << "Invalid ID! Use only letters and numbers.\n";
-            }
+    ~TaskScheduler() {
+        {
+            lock_guard<mutex> guard(sleepLock);
+            stopping = true;
         }
-        return input;
+        wake.notify_all();
+        for(auto& worker : workers) worker->runner.join();
     }
 
-    double getValidDouble(const string& prompt) {
-        string input;
-        double value = 0.0;
-        bool isValidInput = false;
-        while (!isValidInput) {
-            cout << prompt;
-            getline(cin, input);
-            input = trim(input);
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
 
-            bool valid = !input.empty();
-            int decimalPoints = 0;
-            bool hasDigit = false;
+    size_t workerCount() const { return workers.size(); }
 
-            for(char c : input) {
-                if(c == '.') {
-                    if(++decimalPoints > 1) valid = false;
-                } else if(isdigit(c)) {
-                    hasDigit = true;
-                } else {
-                    valid = false;
-                }
-                if(!valid) break;
-            }
+    // Queues task on the calling worker's deque, or round-robin from outside.
+    void submit(function<void()> task) {
+        size_t index = currentWorker();
+        if(index == npos) index = nextQueue.fetch_add(1, memory_order_relaxed) % workers.size();
+        Worker& worker = *workers[index];
+        {
+            lock_guard<mutex> guard(worker.lock);
+            worker.tasks.push_back(std::move(task));
+            worker.maxDepth = max(worker.maxDepth, worker.tasks.size());
+        }
+        queued.fetch_add(1);
+        {
+            lock_guard<mutex> guard(sleepLock);
+        }
+        wake.notify_one();
+    }
 
-            if(valid && hasDigit) {
-                try {
-                    value = stod(input);
-                    isValidInput = true;
-                } catch (const std::invalid_argument& e) {
-                    cout << "Invalid input! Please enter a valid number.\n";
-                } catch (const std::out_of_range& e) {
-                    cout << "Input out of range for a double.\n";
-                }
-            } else {
-                cout << "Invalid input! Use numbers with optional single decimal point.\n";
+    // Calls body(chunkBegin, chunkEnd) over [begin, end) in chunks of grain
+    // and returns once all have run. Chunk boundaries depend only on grain.
+    template <typename Body>
+    void parallelFor(size_t begin, size_t end, size_t grain, Body body) {
+        if(grain == 0) grain = 1;
+        if(end <= begin) return;
+        size_t chunks = (end - begin + grain - 1) / grain;
+        if(chunks == 1) {
+            body(begin, end);
+            return;
+        }
+        atomic<size_t> pending(chunks - 1);
+        for(size_t c = 1; c < chunks; c++) {
+            size_t chunkBegin = begin + c * grain;
+            size_t chunkEnd = min(end, chunkBegin + grain);
+            submit([&body, &pending, chunkBegin, chunkEnd]() {
+                body(chunkBegin, chunkEnd);
+                pending.fetch_sub(1, memory_order_release);
+            });
+        }
+        body(begin, begin + grain);
+        while(pending.load(memory_order_acquire) > 0) {
+            if(!runOne()) this_thread::yield();
+        }
+    }
+
+    // Maps each grain-sized chunk to a partial result and combines the
+    // partials in chunk order, so the result does not depend on scheduling.
+    template <typename T, typename Map, typename Combine>
+    T parallelReduce(size_t begin, size_t end, size_t grain, T identity, Map map, Combine combine) {
+        if(grain == 0) grain = 1;
+        if(end <= begin) return identity;
+        size_t chunks = (end - begin + grain - 1) / grain;
+        vector<T> partials(chunks, identity);
+        parallelFor(0, chunks, 1, [&](size_t first, size_t last) {
+            for(size_t c = first; c < last; c++) {
+                partials[c] = map(begin + c * grain, min(end, begin + (c + 1) * grain));
             }
+        });
+        T result = identity;
+        for(const T& partial : partials) result = combine(result, partial);
+        return result;
+    }
+
+    vector<WorkerStats> stats() {
+        vector<WorkerStats> result;
+        for(auto& worker : workers) {
+            lock_guard<mutex> guard(worker->lock);
+            result.push_back({ worker->executed.load(memory_order_relaxed), worker->steals.load(memory_order_relaxed),
+                               worker->stealAttempts.load(memory_order_relaxed), worker->tasks.size(), worker->maxDepth });
         }
-        return value;
+        return result;
     }
 
-    int getValidInt(const string& prompt) {
-        string input;
-        int value = 0;
-        bool isValidInput = false;
-        while (!isValidInput) {
-            cout << prompt;
-            getline(cin, input);
-            input = trim(input);
+    void displayStats() {
+        cout << "\nScheduler Statistics ---\n";
+        cout << "Workers: " << workers.size() << "\n";
+        vector<WorkerStats> all = stats();
+        for(size_t i = 0; i < all.size(); i++) {
+            cout << "Worker " << i << ": " << all[i].executed << " tasks run, " << all[i].steals << " steals ("
+                 << all[i].stealAttempts << " attempts), queue depth " << all[i].depth
+                 << " (max " << all[i].maxDepth << ")\n";
+        }
+        cout << "Tasks run by waiting callers: " << externalSteals.load(memory_order_relaxed) << "\n\n";
+    }
+};
 
-            bool valid = !input.empty();
-            for(char c : input) {
-                if(!isdigit(c)) {
-                    valid = false;
-                    break;
-                }
-            }
+// Compact employee ID. Alphanumeric IDs of up to 10 characters are packed as
+// 6-bit symbols (in ASCII order, most significant first) into one 64-bit word,
+// so equality is one integer compare and ordering matches string order.
+// Longer or non-alphanumeric IDs set the top bit and refer to a shared,
+// deduplicated pool, so equality stays an integer compare for them too.
+class EmployeeId {
+    static constexpr uint64_t longFlag = 1ull << 63;
+    static constexpr int symbolBits = 6;
+    static constexpr int firstShift = 63 - symbolBits; // bit 63 is the long flag
 
-            if(valid) {
-                try {
-                    value = stoi(input);
-                    isValidInput = true;
-                } catch (const std::invalid_argument& e) {
-                    cout << "Invalid input! Please enter a valid integer.\n";
-                } catch (const std::out_of_range& e) {
-                    cout << "Input out of range for an integer.\n";
-                }
-            } else {
-                cout << "Invalid input! Please enter whole numbers only.\n";
-            }
+    uint64_t value;
+
+    explicit EmployeeId(uint64_t value) : value(value) {}
+
+    static int symbolCode(char c) {
+        if(c >= '0' && c <= '9') return 1 + (c - '0');
+        if(c >= 'A' && c <= 'Z') return 11 + (c - 'A');
+        if(c >= 'a' && c <= 'z') return 37 + (c - 'a');
+        return 0;
+    }
+
+    // Code of the last alphanumeric character before c, which is not one.
+    static int codeBelow(char c) {
+        unsigned char byte = static_cast<unsigned char>(c);
+        if(byte < '0') return 0;
+        if(byte < 'A') return 10;
+        if(byte < 'a') return 36;
+        return 62;
+    }
+
+    static char symbolChar(int code) {
+        if(code <= 10) return static_cast<char>('0' + code - 1);
+        if(code <= 36) return static_cast<char>('A' + code - 11);
+        return static_cast<char>('a' + code - 37);
+    }
+
+    // Packs up to inlineLength leading characters; false if any is not alphanumeric.
+    static bool packPrefix(string_view text, uint64_t& packed) {
+        packed = 0;
+        size_t count = text.length() < inlineLength ? text.length() : inlineLength;
+        for(size_t i = 0; i < count; i++) {
+            int code = symbolCode(text[i]);
+            if(code == 0) return false;
+            packed |= static_cast<uint64_t>(code) << (firstShift - symbolBits * i);
         }
-        return value;
+        return true;
     }
 
-    string getValidName() {
-        string input;
-        bool isValidInput = false;
-        while (!isValidInput) {
-            cout << "Enter Name: ";
-            getline(cin, input);
-            input = trim(input);
+    // Long IDs are striped by text hash so concurrent writers rarely share a
+    // lock; the stripe sits in the low bits of the value.
+    static constexpr size_t longStripes = 16;
 
-            bool valid = !input.empty();
-            bool prevSpace = false;
+    struct alignas(64) LongPool {
+        mutex lock;
+        deque<string> texts;
+        unordered_map<string, uint64_t> indexByText;
+    };
 
-            for(char c : input) {
-                if(isspace(c)) {
-                    if(prevSpace) valid = false;
-                    prevSpace = true;
-                } else {
-                    if(!isalpha(c)) valid = false;
-                    prevSpace = false;
-                }
-                if(!valid) break;
+    static LongPool& longPool(size_t stripe) {
+        static LongPool pools[longStripes];
+        return pools[stripe];
+    }
+
+    static size_t longStripeOf(string_view text) { return hash<string_view>()(text) % longStripes; }
+
+public:
+    static constexpr size_t inlineLength = 10;
+
+    EmployeeId() : value(0) {}
+    EmployeeId(const string& text) : value(fromString(text).value) {}
+    EmployeeId(const char* text) : EmployeeId(string(text)) {}
+
+    static EmployeeId fromString(const string& text) {
+        uint64_t packed;
+        if(text.length() <= inlineLength && packPrefix(text, packed)) {
+            return EmployeeId(packed);
+        }
+        AllocScope scope(AllocCategory::Index);
+        size_t stripe = longStripeOf(text);
+        LongPool& pool = longPool(stripe);
+        lock_guard<mutex> guard(pool.lock);
+        auto found = pool.indexByText.find(text);
+        if(found != pool.indexByText.end()) return EmployeeId(longFlag | found->second);
+        uint64_t index = pool.texts.size() * longStripes + stripe;
+        pool.texts.push_back(text);
+        pool.indexByText.emplace(text, index);
+        return EmployeeId(longFlag | index);
+    }
+
+    // Like fromString but never interns: false if text is a long ID nobody has used.
+    static bool lookup(string_view text, EmployeeId& out) {
+        uint64_t packed;
+        if(text.empty()) return false;
+        if(text.length() <= inlineLength && packPrefix(text, packed)) {
+            out = EmployeeId(packed);
+            return true;
+        }
+        LongPool& pool = longPool(longStripeOf(text));
+        lock_guard<mutex> guard(pool.lock);
+        auto found = pool.indexByText.find(string(text));
+        if(found == pool.indexByText.end()) return false;
+        out = EmployeeId(longFlag | found->second);
+        return true;
+    }
+
+    bool isInline() const { return (value & longFlag) == 0; }
+    uint64_t raw() const { return value; }
+    // Inverse of raw(), for IDs written out within the same process.
+    static EmployeeId fromRaw(uint64_t raw) { return EmployeeId(raw); }
+
+    void appendTo(string& out) const {
+        if(isInline()) {
+            for(int shift = firstShift; shift >= 0; shift -= symbolBits) {
+                int code = static_cast<int>((value >> shift) & 63);
+                if(code == 0) break;
+                out += symbolChar(code);
             }
+            return;
+        }
+        uint64_t index = value & ~longFlag;
+        LongPool& pool = longPool(index % longStripes);
+        lock_guard<mutex> guard(pool.lock);
+        out += pool.texts[index / longStripes];
+    }
 
-            if(valid) {
-                isValidInput = true;
-            } else {
-                cout << "Invalid name! Use letters and single spaces between names.\n";
+    string str() const {
+        string out;
+        appendTo(out);
+        return out;
+    }
+
+    // Order-preserving 64-bit key over the first inlineLength characters:
+    // a < b implies a.sortKey() <= b.sortKey(). Equal to raw() for inline IDs;
+    // long IDs sharing a key need a string tie-break.
+    uint64_t sortKey() const {
+        if(isInline()) return value;
+        string text = str();
+        uint64_t key = 0;
+        size_t count = text.length() < inlineLength ? text.length() : inlineLength;
+        for(size_t i = 0; i < count; i++) {
+            int shift = firstShift - symbolBits * static_cast<int>(i);
+            int code = symbolCode(text[i]);
+            if(code == 0) {
+                // Stand in the closest symbol below the character and fill the
+                // rest with ones, so the key sorts after every ID with that prefix.
+                return key | (static_cast<uint64_t>(codeBelow(text[i])) << shift) | ((1ull << shift) - 1);
             }
+            key |= static_cast<uint64_t>(code) << shift;
+        }
+        return key;
+    }
+
+    bool operator==(const EmployeeId& other) const { return value == other.value; }
+    bool operator!=(const EmployeeId& other) const { return value != other.value; }
+    bool operator<(const EmployeeId& other) const {
+        if(isInline() && other.isInline()) return value < other.value;
+        return str() < other.str();
+    }
+};
+
+inline uint64_t mixBits(uint64_t x) {
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27; x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+struct EmployeeIdHash {
+    size_t operator()(const EmployeeId& id) const { return static_cast<size_t>(mixBits(id.raw())); }
+};
+
+// Open-addressing map from EmployeeId to a 32-bit value (the employee's handle
+// slot): two flat arrays, linear probing, no per-entry allocation.
+class IdIndex {
+    static constexpr uint64_t emptyKey = ~0ull;
+
+    vector<uint64_t> keys;
+    vector<uint32_t> rows;
+    size_t count = 0;
+
+    size_t slotFor(uint64_t key) const {
+        size_t mask = keys.size() - 1;
+        size_t slot = static_cast<size_t>(mixBits(key)) & mask;
+        while(keys[slot] != emptyKey && keys[slot] != key) slot = (slot + 1) & mask;
+        return slot;
+    }
+
+    void grow() {
+        vector<uint64_t> oldKeys;
+        vector<uint32_t> oldRows;
+        oldKeys.swap(keys);
+        oldRows.swap(rows);
+        size_t capacity = oldKeys.empty() ? 16 : oldKeys.size() * 2;
+        keys.assign(capacity, emptyKey);
+        rows.assign(capacity, 0);
+        for(size_t i = 0; i < oldKeys.size(); i++) {
+            if(oldKeys[i] == emptyKey) continue;
+            size_t slot = slotFor(oldKeys[i]);
+            keys[slot] = oldKeys[i];
+            rows[slot] = oldRows[i];
         }
-        return input;
     }
 
 public:
-    string trim(const string& str) {
-        if(str.empty()) return "";
+    static constexpr uint32_t npos = ~0u;
 
-        size_t start = 0;
-        size_t end = str.length() - 1;
+    uint32_t find(const EmployeeId& id) const {
+        if(keys.empty()) return npos;
+        size_t slot = slotFor(id.raw());
+        return keys[slot] == emptyKey ? npos : rows[slot];
+    }
 
-        while(start <= end && isspace(str[start])) start++;
-        while(end >= start && isspace(str[end])) end--;
+    bool contains(const EmployeeId& id) const { return find(id) != npos; }
 
-        return str.substr(start, end - start + 1);
+    // False if the ID is already present.
+    bool insert(const EmployeeId& id, uint32_t row) {
+        if((count + 1) * 4 > keys.size() * 3) grow(); // max load 0.75
+        size_t slot = slotFor(id.raw());
+        if(keys[slot] != emptyKey) return false;
+        keys[slot] = id.raw();
+        rows[slot] = row;
+        count++;
+        return true;
     }
 
-    void addEmployee(int type) {
-        string id = getValidID();
-        string name = getValidName();
+    // Inserts, or points an existing ID at row.
+    void assign(const EmployeeId& id, uint32_t row) {
+        if((count + 1) * 4 > keys.size() * 3) grow();
+        size_t slot = slotFor(id.raw());
+        if(keys[slot] == emptyKey) {
+            keys[slot] = id.raw();
+            count++;
+        }
+        rows[slot] = row;
+    }
 
-        switch(type) {
-            case 1: {
-                double salary = getValidDouble("Monthly Salary: $");
-                employees.push_back(new FullTimeEmployee(id, name, salary));
-                break;
-            }
-            case 2: {
-                double rate = getValidDouble("Hourly Rate: $");
-                int hours = getValidInt("Hours Worked: ");
-                employees.push_back(new PartTimeEmployee(id, name, rate, hours));
-                break;
-            }
-            case 3: {
-                double rate = getValidDouble("Payment Per Project: $");
-                int projects = getValidInt("Projects Completed: ");
-                employees.push_back(new ContractualEmployee(id, name, rate, projects));
-                break;
+    // Backward-shift deletion keeps probe chains intact without tombstones.
+    bool erase(const EmployeeId& id) {
+        if(keys.empty()) return false;
+        size_t mask = keys.size() - 1;
+        size_t hole = slotFor(id.raw());
+        if(keys[hole] == emptyKey) return false;
+        size_t next = (hole + 1) & mask;
+        while(keys[next] != emptyKey) {
+            size_t home = static_cast<size_t>(mixBits(keys[next])) & mask;
+            // Move the entry back if its home slot is not in (hole, next].
+            if(((next - home) & mask) >= ((next - hole) & mask)) {
+                keys[hole] = keys[next];
+                rows[hole] = rows[next];
+                hole = next;
             }
+            next = (next + 1) & mask;
         }
-        cout << "Employee added!\n\n";
+        keys[hole] = emptyKey;
+        count--;
+        return true;
     }
 
-    void displayPayrollReport() const {
-        if(employees.empty()) {
-            cout << "No employees in system!\n\n";
-            return;
+    void reserve(size_t expected) {
+        while(expected * 4 > keys.size() * 3) grow();
+    }
+
+    size_t size() const { return count; }
+    size_t memoryBytes() const { return keys.capacity() * sizeof(uint64_t) + rows.capacity() * sizeof(uint32_t); }
+};
+
+// Lock-free set of claimed employee IDs for parallel ingest: open addressing
+// over atomic slots holding the packed ID, claimed with a single CAS, so
+// "check and claim" is one atomic step. Erased slots keep a marker until the
+// next rehash. Growing is cooperative: operations register in active, and the
+// thread that triggers a resize waits for them to drain before rehashing.
+class ConcurrentIdSet {
+    static constexpr uint64_t emptyKey = 0; // no valid ID packs to zero
+    static constexpr uint64_t erasedKey = ~0ull;
+    static constexpr size_t minCapacity = 1024;
+
+    struct Table {
+        size_t mask;
+        unique_ptr<atomic<uint64_t>[]> slots;
+        atomic<size_t> used{0}; // claimed slots, erased ones included
+
+        explicit Table(size_t capacity) : mask(capacity - 1), slots(new atomic<uint64_t>[capacity]) {
+            for(size_t i = 0; i < capacity; i++) slots[i].store(emptyKey, memory_order_relaxed);
         }
-        cout << "\nEmployee Payroll Report ---\n";
-        for(const auto& emp : employees) {
-            emp->display();
+    };
+
+    atomic<Table*> table;
+    atomic<size_t> live{0};
+    atomic<int> active{0};
+    atomic<bool> resizing{false};
+    atomic<size_t> resizes{0};
+    mutex resizeLock;
+
+    Table* enter() {
+        for(;;) {
+            active.fetch_add(1);
+            if(!resizing.load()) return table.load(memory_order_acquire);
+            active.fetch_sub(1);
+            while(resizing.load(memory_order_acquire)) this_thread::yield();
         }
     }
 
-    ~PayrollSystem() {
-        for(auto& emp : employees) {
-            delete emp;
+    void leave() { active.fetch_sub(1, memory_order_release); }
+
+    // Rehashes into a table of at least capacity slots unless another thread
+    // already replaced seen.
+    void rebuild(Table* seen, size_t capacity) {
+        lock_guard<mutex> guard(resizeLock);
+        if(table.load(memory_order_acquire) != seen) return;
+        resizing.store(true);
+        while(active.load() != 0) this_thread::yield();
+
+        size_t needed = minCapacity;
+        while(needed < capacity || needed < live.load(memory_order_relaxed) * 2 + 2) needed <<= 1;
+        Table* next;
+        {
+            AllocScope scope(AllocCategory::Index);
+            next = new Table(needed);
+        }
+        for(size_t i = 0; i <= seen->mask; i++) {
+            uint64_t key = seen->slots[i].load(memory_order_relaxed);
+            if(key == emptyKey || key == erasedKey) continue;
+            size_t slot = static_cast<size_t>(mixBits(key)) & next->mask;
+            while(next->slots[slot].load(memory_order_relaxed) != emptyKey) slot = (slot + 1) & next->mask;
+            next->slots[slot].store(key, memory_order_relaxed);
+            next->used.fetch_add(1, memory_order_relaxed);
         }
+        table.store(next, memory_order_release);
+        delete seen;
+        resizes.fetch_add(1, memory_order_relaxed);
+        resizing.store(false, memory_order_release);
     }
-};
 
-int main() {
+public:
+    ConcurrentIdSet() {
+        AllocScope scope(AllocCategory::Index);
+        table.store(new Table(minCapacity));
+    }
+
+    ~ConcurrentIdSet() { delete table.load(); }
+
+    ConcurrentIdSet(const ConcurrentIdSet&) = delete;
+    ConcurrentIdSet& operator=(const ConcurrentIdSet&) = delete;
+
+    // Claims id; false if it was already claimed.
+    bool insert(const EmployeeId& id) {
+        uint64_t key = id.raw();
+        for(;;) {
+            Table* t = enter();
+            size_t capacity = t->mask + 1;
+            if((t->used.load(memory_order_relaxed) + 1) * 4 > capacity * 3) {
+                leave(); // t may be freed from here on; rebuild only compares it
+                rebuild(t, capacity * 2);
+                continue;
+            }
+            size_t slot = static_cast<size_t>(mixBits(key)) & t->mask;
+            for(;;) {
+                uint64_t current = t->slots[slot].load(memory_order_acquire);
+                if(current == key) {
+                    leave();
+                    return false;
+                }
+                if(current != emptyKey) {
+                    slot = (slot + 1) & t->mask;
+                    continue;
+                }
+                if(t->slots[slot].compare_exchange_strong(current, key, memory_order_acq_rel)) {
+                    t->used.fetch_add(1, memory_order_relaxed);
+                    live.fetch_add(1, memory_order_relaxed);
+                    leave();
+                    return true;
+                }
+                // Lost the slot; re-examine it, it may now hold this very ID.
+            }
+        }
+    }
+
+    bool contains(const EmployeeId& id) {
+        uint64_t key = id.raw();
+        Table* t = enter();
+        size_t slot = static_cast<size_t>(mixBits(key)) & t->mask;
+        uint64_t current;
+        while((current = t->slots[slot].load(memory_order_acquire)) != emptyKey && current != key) {
+            slot = (slot + 1) & t->mask;
+        }
+        leave();
+        return current == key;
+    }
+
+    // Releases a claim so the ID can be claimed again.
+    bool erase(const EmployeeId& id) {
+        uint64_t key = id.raw();
+        Table* t = enter();
+        size_t slot = static_cast<size_t>(mixBits(key)) & t->mask;
+        for(;;) {
+            uint64_t current = t->slots[slot].load(memory_order_acquire);
+            if(current == emptyKey) break;
+            if(current == key && t->slots[slot].compare_exchange_strong(current, erasedKey, memory_order_acq_rel)) {
+                live.fetch_sub(1, memory_order_relaxed);
+                leave();
+                return true;
+            }
+            if(current == key) continue;
+            slot = (slot + 1) & t->mask;
+        }
+        leave();
+        return false;
+    }
+
+    void reserve(size_t expected) {
+        Table* t = enter();
+        size_t capacity = t->mask + 1;
+        leave();
+        if(expected * 4 > capacity * 3) rebuild(t, expected * 2);
+    }
+
+    size_t size() const { return live.load(memory_order_relaxed); }
+    size_t resizeCount() const { return resizes.load(memory_order_relaxed); }
+    // Not const: the table is pinned like a lookup, since a resize may free it.
+    size_t memoryBytes() {
+        Table* t = enter();
+        size_t capacity = t->mask + 1;
+        leave();
+        return capacity * sizeof(uint64_t);
+    }
+};
+
+// Deduplicating pool for employee names. Each distinct name is copied once into
+// an arena of fixed-size chunks that never move, so the returned string_view
+// stays valid for the life of the program. The pool is split into stripes by
+// name hash, each with its own lock, arena and table, so threads interning
+// different names (e.g. into different shards) rarely contend; a name always
+// lands in the same stripe, so it is still stored once.
+class NamePool {
+    static constexpr size_t chunkSize = 64 * 1024;
+    static constexpr size_t stripeCount = 16;
+
+    struct alignas(64) Stripe {
+        mutex lock;
+        vector<unique_ptr<char[]>> chunks;
+        size_t chunkUsed = chunkSize;
+        size_t arenaBytes = 0; // reserved in chunks
+        size_t arenaUsed = 0;
+        unordered_set<string_view> names;
+        size_t internCalls = 0;
+        size_t requestedBytes = 0;
+        size_t plainStringBytes = 0;
+
+        string_view store(string_view text) {
+            if(text.size() > chunkSize) {
+                chunks.emplace_back(new char[text.size()]);
+                arenaBytes += text.size();
+                arenaUsed += text.size();
+                text.copy(chunks.back().get(), text.size());
+                return string_view(chunks.back().get(), text.size());
+            }
+            if(chunkUsed + text.size() > chunkSize) {
+                chunks.emplace_back(new char[chunkSize]);
+                arenaBytes += chunkSize;
+                chunkUsed = 0;
+            }
+            char* dest = chunks.back().get() + chunkUsed;
+            text.copy(dest, text.size());
+            chunkUsed += text.size();
+            arenaUsed += text.size();
+            return string_view(dest, text.size());
+        }
+    };
+
+    Stripe stripes[stripeCount];
+
+public:
+    struct Stats {
+        size_t internCalls;
+        size_t uniqueNames;
+        size_t requestedBytes;   // characters handed to intern()
+        size_t plainStringBytes; // what one std::string per employee would cost
+        size_t pooledBytes;      // used arena + dedup tables + one string_view per employee
+        size_t arenaReserved;
+    };
+
+    static NamePool& instance() {
+        static NamePool pool;
+        return pool;
+    }
+
+    string_view intern(string_view text) {
+        AllocScope scope(AllocCategory::Employee);
+        size_t hashed = hash<string_view>()(text);
+        Stripe& stripe = stripes[hashed % stripeCount];
+        lock_guard<mutex> guard(stripe.lock);
+        stripe.internCalls++;
+        stripe.requestedBytes += text.size();
+        stripe.plainStringBytes += sizeof(string) + (text.size() > 15 ? text.size() + 1 : 0);
+        auto found = stripe.names.find(text);
+        if(found != stripe.names.end()) return *found;
+        string_view stored = stripe.store(text);
+        stripe.names.insert(stored);
+        return stored;
+    }
+
+    Stats stats() {
+        Stats total = {};
+        for(Stripe& stripe : stripes) {
+            lock_guard<mutex> guard(stripe.lock);
+            size_t tableBytes = stripe.names.bucket_count() * sizeof(void*)
+                              + stripe.names.size() * (sizeof(string_view) + 2 * sizeof(void*));
+            total.internCalls += stripe.internCalls;
+            total.uniqueNames += stripe.names.size();
+            total.requestedBytes += stripe.requestedBytes;
+            total.plainStringBytes += stripe.plainStringBytes;
+            total.pooledBytes += stripe.arenaUsed + tableBytes + stripe.internCalls * sizeof(string_view);
+            total.arenaReserved += stripe.arenaBytes;
+        }
+        return total;
+    }
+};
+
+enum class EmployeeType { FullTime, PartTime, Contractual, Count };
+
+const char* employeeTypeName(EmployeeType type) {
+    switch(type) {
+        case EmployeeType::FullTime: return "Full-time";
+        case EmployeeType::PartTime: return "Part-time";
+        case EmployeeType::Contractual: return "Contractual";
+        default: return "Unknown";
+    }
+}
+
+class Employee {
+protected:
+    EmployeeId id;
+    string_view name; // interned in NamePool
+    double salary;
+
+public:
+    Employee(EmployeeId id, string_view name, double salary)
+        : id(id), name(NamePool::instance().intern(name)), salary(salary) {}
+
+    // Appends the report entry to out; reuses out's capacity.
+    virtual void render(string& out) const = 0;
+    virtual EmployeeType getType() const = 0;
+    // Stored employees are never modified in place; updates edit a clone.
+    virtual Employee* clone() const = 0;
+    virtual ~Employee() {}
+
+    void display() const {
+        string out;
+        render(out);
+        cout << out;
+    }
+
+    EmployeeId getId() const { return id; }
+    string_view getName() const { return name; }
+    double getSalary() const { return salary; }
+};
+
+class FullTimeEmployee : public Employee {
+public:
+    FullTimeEmployee(EmployeeId id, string_view name, double salary)
+        : Employee(id, name, salary) {}
+
+    void render(string& out) const {
+        out += "Employee: "; out += name; out += " (ID: "; id.appendTo(out); out += ")\n";
+        out += "Fixed Monthly Salary: $"; appendNumber(out, salary); out += "\n\n";
+    }
+
+    EmployeeType getType() const { return EmployeeType::FullTime; }
+    Employee* clone() const { return new FullTimeEmployee(*this); }
+
+    void setSalary(double monthlySalary) {
+        if(monthlySalary >= 0) salary = monthlySalary;
+    }
+};
+
+class PartTimeEmployee : public Employee {
+    double hourlyRate;
+    int hoursWorked;
+
+public:
+    PartTimeEmployee(EmployeeId id, string_view name, double hourlyRate, int hoursWorked)
+        : Employee(id, name, hourlyRate * hoursWorked),
+          hourlyRate(hourlyRate), hoursWorked(hoursWorked) {}
+
+    void render(string& out) const {
+        out += "Employee: "; out += name; out += " (ID: "; id.appendTo(out); out += ")\n";
+        out += "Hourly Rate: $"; appendNumber(out, hourlyRate); out += "\n";
+        out += "Hours Worked: "; appendNumber(out, hoursWorked); out += "\n";
+        out += "Total Salary: $"; appendNumber(out, salary); out += "\n\n";
+    }
+
+    EmployeeType getType() const { return EmployeeType::PartTime; }
+    Employee* clone() const { return new PartTimeEmployee(*this); }
+
+    double getHourlyRate() const { return hourlyRate; }
+    int getHoursWorked() const { return hoursWorked; }
+
+    void setHourlyRate(double rate) {
+        if(rate >= 0) {
+            hourlyRate = rate;
+            salary = hourlyRate * hoursWorked;
+        }
+    }
+
+    void setHoursWorked(int hours) {
+        if(hours >= 0) {
+            hoursWorked = hours;
+            salary = hourlyRate * hoursWorked;
+        }
+    }
+};
+
+class ContractualEmployee : public Employee {
+    double paymentPerProject;
+    int projectsCompleted;
+
+public:
+    ContractualEmployee(EmployeeId id, string_view name, double paymentPerProject, int projectsCompleted)
+        : Employee(id, name, paymentPerProject * projectsCompleted),
+          paymentPerProject(paymentPerProject), projectsCompleted(projectsCompleted) {}
+
+    void render(string& out) const {
+        out += "Employee: "; out += name; out += " (ID: "; id.appendTo(out); out += ")\n";
+        out += "Contract Payment Per Project: $"; appendNumber(out, paymentPerProject); out += "\n";
+        out += "Projects Completed: "; appendNumber(out, projectsCompleted); out += "\n";
+        out += "Total Salary: $"; appendNumber(out, salary); out += "\n\n";
+    }
+
+    EmployeeType getType() const { return EmployeeType::Contractual; }
+    Employee* clone() const { return new ContractualEmployee(*this); }
+
+    double getPaymentPerProject() const { return paymentPerProject; }
+    int getProjectsCompleted() const { return projectsCompleted; }
+
+    void setPaymentPerProject(double payment) {
+        if(payment >= 0) {
+            paymentPerProject = payment;
+            salary = paymentPerProject * projectsCompleted;
+        }
+    }
+
+    void setProjectsCompleted(int projects) {
+        if(projects >= 0) {
+            projectsCompleted = projects;
+            salary = paymentPerProject * projectsCompleted;
+        }
+    }
+};
+
+// Generational handle to an employee: a slot in the roster's HandleTable plus
+// the generation the slot had when the handle was issued. Handles survive
+// compaction; a handle to a removed employee is detected by its generation.
+struct EmployeeHandle {
+    uint32_t slot;
+    uint32_t generation;
+
+    bool operator==(const EmployeeHandle& other) const {
+        return slot == other.slot && generation == other.generation;
+    }
+    bool operator!=(const EmployeeHandle& other) const { return !(*this == other); }
+};
+
+// Compact sort record: an order-preserving 64-bit key plus the storage row,
+// so reports never sort the polymorphic pointer vector itself.
+struct SortEntry {
+    uint64_t key;
+    uint32_t row;
+};
+
+// Maps a double to an unsigned key with the same ordering.
+inline uint64_t orderedKey(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return (bits & (1ull << 63)) ? ~bits : bits | (1ull << 63);
+}
+
+// Stable LSD radix sort on key, one byte per pass; passes where every entry
+// shares the same byte are skipped.
+void radixSort(vector<SortEntry>& entries) {
+    if(entries.size() < 2) return;
+    size_t counts[8][256] = {};
+    for(const auto& entry : entries) {
+        for(int pass = 0; pass < 8; pass++) counts[pass][(entry.key >> (8 * pass)) & 0xff]++;
+    }
+
+    vector<SortEntry> scratch(entries.size());
+    for(int pass = 0; pass < 8; pass++) {
+        size_t* count = counts[pass];
+        if(count[(entries[0].key >> (8 * pass)) & 0xff] == entries.size()) continue;
+
+        size_t offsets[256];
+        size_t sum = 0;
+        for(int b = 0; b < 256; b++) {
+            offsets[b] = sum;
+            sum += count[b];
+        }
+        for(const auto& entry : entries) {
+            scratch[offsets[(entry.key >> (8 * pass)) & 0xff]++] = entry;
+        }
+        entries.swap(scratch);
+    }
+}
+
+// The k entries with the smallest (key, row), in order, via a bounded max-heap.
+vector<SortEntry> smallestEntries(const vector<SortEntry>& entries, size_t k) {
+    auto before = [](const SortEntry& a, const SortEntry& b) {
+        return a.key != b.key ? a.key < b.key : a.row < b.row;
+    };
+    vector<SortEntry> heap;
+    if(k == 0) return heap;
+    heap.reserve(k);
+    for(const auto& entry : entries) {
+        if(heap.size() < k) {
+            heap.push_back(entry);
+            push_heap(heap.begin(), heap.end(), before);
+        } else if(before(entry, heap.front())) {
+            pop_heap(heap.begin(), heap.end(), before);
+            heap.back() = entry;
+            push_heap(heap.begin(), heap.end(), before);
+        }
+    }
+    sort_heap(heap.begin(), heap.end(), before);
+    return heap;
+}
+
+// Ordered secondary index on total salary: a sorted sequence of (key, slot)
+// split into blocks of at most maxBlock entries, with each block's first key
+// kept in a separate array. Lookups binary-search the block directory and then
+// one block, so range queries cost O(log n) plus the entries returned.
+class SalaryIndex {
+    static constexpr size_t maxBlock = 512;
+
+    struct Block {
+        vector<uint64_t> keys;
+        vector<uint32_t> rows;
+    };
+
+    vector<Block> blocks;
+    vector<uint64_t> firstKeys;
+    size_t count = 0;
+
+    // Last block whose first key is <= key (0 if key precedes everything).
+    size_t blockFor(uint64_t key) const {
+        size_t block = upper_bound(firstKeys.begin(), firstKeys.end(), key) - firstKeys.begin();
+        return block == 0 ? 0 : block - 1;
+    }
+
+    // First block that may hold entries >= key.
+    size_t firstBlockAtLeast(uint64_t key) const {
+        size_t block = lower_bound(firstKeys.begin(), firstKeys.end(), key) - firstKeys.begin();
+        return block == 0 ? 0 : block - 1;
+    }
+
+    template <typename Visit>
+    void scan(double low, double high, Visit visit) const {
+        if(blocks.empty() || low > high) return;
+        uint64_t lowKey = orderedKey(low);
+        uint64_t highKey = orderedKey(high);
+        for(size_t b = firstBlockAtLeast(lowKey); b < blocks.size() && firstKeys[b] <= highKey; b++) {
+            const Block& block = blocks[b];
+            size_t begin = lower_bound(block.keys.begin(), block.keys.end(), lowKey) - block.keys.begin();
+            size_t end = upper_bound(block.keys.begin() + begin, block.keys.end(), highKey) - block.keys.begin();
+            visit(block, begin, end);
+        }
+    }
+
+public:
+    void insert(double salary, uint32_t row) {
+        uint64_t key = orderedKey(salary);
+        if(blocks.empty()) {
+            blocks.emplace_back();
+            firstKeys.push_back(key);
+        }
+        size_t b = blockFor(key);
+        Block& block = blocks[b];
+        size_t pos = upper_bound(block.keys.begin(), block.keys.end(), key) - block.keys.begin();
+        block.keys.insert(block.keys.begin() + pos, key);
+        block.rows.insert(block.rows.begin() + pos, row);
+        firstKeys[b] = block.keys.front();
+        count++;
+
+        if(block.keys.size() > maxBlock) {
+            Block upper;
+            size_t half = block.keys.size() / 2;
+            upper.keys.assign(block.keys.begin() + half, block.keys.end());
+            upper.rows.assign(block.rows.begin() + half, block.rows.end());
+            block.keys.resize(half);
+            block.rows.resize(half);
+            uint64_t upperFirst = upper.keys.front();
+            blocks.insert(blocks.begin() + b + 1, std::move(upper));
+            firstKeys.insert(firstKeys.begin() + b + 1, upperFirst);
+        }
+    }
+
+    bool erase(double salary, uint32_t row) {
+        uint64_t key = orderedKey(salary);
+        for(size_t b = firstBlockAtLeast(key); b < blocks.size() && firstKeys[b] <= key; b++) {
+            Block& block = blocks[b];
+            size_t pos = lower_bound(block.keys.begin(), block.keys.end(), key) - block.keys.begin();
+            for(; pos < block.keys.size() && block.keys[pos] == key; pos++) {
+                if(block.rows[pos] != row) continue;
+                block.keys.erase(block.keys.begin() + pos);
+                block.rows.erase(block.rows.begin() + pos);
+                count--;
+                if(block.keys.empty() && blocks.size() > 1) {
+                    blocks.erase(blocks.begin() + b);
+                    firstKeys.erase(firstKeys.begin() + b);
+                } else if(!block.keys.empty()) {
+                    firstKeys[b] = block.keys.front();
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Rows with low <= salary <= high, in ascending salary order.
+    vector<uint32_t> range(double low, double high) const {
+        vector<uint32_t> rows;
+        scan(low, high, [&](const Block& block, size_t begin, size_t end) {
+            rows.insert(rows.end(), block.rows.begin() + begin, block.rows.begin() + end);
+        });
+        return rows;
+    }
+
+    size_t countInRange(double low, double high) const {
+        size_t total = 0;
+        scan(low, high, [&](const Block&, size_t begin, size_t end) { total += end - begin; });
+        return total;
+    }
+
+    size_t size() const { return count; }
+};
+
+// Compressed bitmap over 32-bit values (handle slots), roaring style: values
+// are grouped by their high 16 bits, and each group is a sorted uint16_t array
+// while sparse or a 65536-bit bitmap once it holds more than arrayLimit values.
+class RoaringBitmap {
+    static constexpr size_t arrayLimit = 4096;
+    static constexpr size_t bitmapWords = 65536 / 64;
+
+    struct Container {
+        vector<uint16_t> array;
+        vector<uint64_t> bits; // non-empty once converted to a bitmap
+        uint32_t cardinality = 0;
+
+        bool isBitmap() const { return !bits.empty(); }
+    };
+
+    vector<uint16_t> highKeys;
+    vector<Container> containers;
+    size_t count = 0;
+
+    Container* find(uint16_t high) {
+        auto it = lower_bound(highKeys.begin(), highKeys.end(), high);
+        if(it == highKeys.end() || *it != high) return nullptr;
+        return &containers[it - highKeys.begin()];
+    }
+
+    const Container* find(uint16_t high) const {
+        return const_cast<RoaringBitmap*>(this)->find(high);
+    }
+
+    static void toBitmap(Container& c) {
+        c.bits.assign(bitmapWords, 0);
+        for(uint16_t low : c.array) c.bits[low >> 6] |= 1ull << (low & 63);
+        vector<uint16_t>().swap(c.array);
+    }
+
+public:
+    void add(uint32_t row) {
+        uint16_t high = static_cast<uint16_t>(row >> 16);
+        uint16_t low = static_cast<uint16_t>(row & 0xffff);
+        // Rows are usually appended, so try the last container first.
+        Container* c = (!highKeys.empty() && highKeys.back() == high) ? &containers.back() : find(high);
+        if(!c) {
+            auto it = lower_bound(highKeys.begin(), highKeys.end(), high);
+            size_t pos = it - highKeys.begin();
+            highKeys.insert(it, high);
+            containers.insert(containers.begin() + pos, Container());
+            c = &containers[pos];
+        }
+        if(c->isBitmap()) {
+            uint64_t mask = 1ull << (low & 63);
+            if(c->bits[low >> 6] & mask) return;
+            c->bits[low >> 6] |= mask;
+        } else {
+            auto it = (c->array.empty() || c->array.back() < low)
+                    ? c->array.end() : lower_bound(c->array.begin(), c->array.end(), low);
+            if(it != c->array.end() && *it == low) return;
+            c->array.insert(it, low);
+            if(c->array.size() > arrayLimit) toBitmap(*c);
+        }
+        c->cardinality++;
+        count++;
+    }
+
+    void remove(uint32_t row) {
+        uint16_t high = static_cast<uint16_t>(row >> 16);
+        uint16_t low = static_cast<uint16_t>(row & 0xffff);
+        auto keyIt = lower_bound(highKeys.begin(), highKeys.end(), high);
+        if(keyIt == highKeys.end() || *keyIt != high) return;
+        size_t index = keyIt - highKeys.begin();
+        Container& c = containers[index];
+        if(c.isBitmap()) {
+            uint64_t mask = 1ull << (low & 63);
+            if(!(c.bits[low >> 6] & mask)) return;
+            c.bits[low >> 6] &= ~mask;
+        } else {
+            auto it = lower_bound(c.array.begin(), c.array.end(), low);
+            if(it == c.array.end() || *it != low) return;
+            c.array.erase(it);
+        }
+        count--;
+        if(--c.cardinality == 0) {
+            highKeys.erase(keyIt);
+            containers.erase(containers.begin() + index);
+        }
+    }
+
+    bool contains(uint32_t row) const {
+        const Container* c = find(static_cast<uint16_t>(row >> 16));
+        if(!c) return false;
+        uint16_t low = static_cast<uint16_t>(row & 0xffff);
+        if(c->isBitmap()) return (c->bits[low >> 6] >> (low & 63)) & 1;
+        return binary_search(c->array.begin(), c->array.end(), low);
+    }
+
+    // Calls visit(row) for every set row in ascending order, touching only set bits.
+    template <typename Visit>
+    void forEach(Visit visit) const {
+        for(size_t i = 0; i < containers.size(); i++) forEachInContainer(i, visit);
+    }
+
+    // Containers cover disjoint, ascending 65536-row spans; callers can
+    // split work along them.
+    size_t containerCount() const { return containers.size(); }
+
+    template <typename Visit>
+    void forEachInContainer(size_t index, Visit& visit) const {
+        uint32_t base = static_cast<uint32_t>(highKeys[index]) << 16;
+        const Container& c = containers[index];
+        if(c.isBitmap()) {
+            for(size_t w = 0; w < bitmapWords; w++) {
+                uint64_t word = c.bits[w];
+                while(word) {
+                    visit(base | static_cast<uint32_t>(w * 64 + __builtin_ctzll(word)));
+                    word &= word - 1;
+                }
+            }
+        } else {
+            for(uint16_t low : c.array) visit(base | low);
+        }
+    }
+
+    size_t size() const { return count; }
+
+    size_t memoryBytes() const {
+        size_t total = highKeys.capacity() * sizeof(uint16_t) + containers.capacity() * sizeof(Container);
+        for(const auto& c : containers) {
+            total += c.array.capacity() * sizeof(uint16_t) + c.bits.capacity() * sizeof(uint64_t);
+        }
+        return total;
+    }
+};
+
+// ASCII-only, like tolower in the "C" locale, but inlined.
+inline char foldCase(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+// Case-insensitive prefix index over interned names. Every word start of a
+// name is an entry (a string_view suffix into the NamePool arena), so "gar"
+// finds "Maria Garcia". Inserts are buffered and merged into the sorted
+// array on the next query, or once they reach an eighth of it, which bounds
+// the merge a query can hit. Removal marks the sorted entries dead; marked
+// and stale entries are dropped by the next merge and by prune().
+class NamePrefixIndex {
+    struct Entry {
+        string_view text;
+        EmployeeHandle handle;
+    };
+
+    // Generation of a removed entry; never issued while the slot is live.
+    static constexpr uint32_t removedGeneration = ~0u;
+    static constexpr size_t minMergeBatch = 65536;
+
+    mutable vector<Entry> sorted;
+    mutable vector<Entry> pending;
+    mutable size_t removed = 0; // marked entries in sorted
+
+    static int compareFolded(string_view a, string_view b) {
+        size_t n = a.size() < b.size() ? a.size() : b.size();
+        for(size_t i = 0; i < n; i++) {
+            char x = foldCase(a[i]), y = foldCase(b[i]);
+            if(x != y) return x < y ? -1 : 1;
+        }
+        return a.size() < b.size() ? -1 : (a.size() > b.size() ? 1 : 0);
+    }
+
+    static bool lessFolded(string_view a, string_view b) { return compareFolded(a, b) < 0; }
+
+    static bool startsWithFolded(string_view text, string_view prefix) {
+        if(text.size() < prefix.size()) return false;
+        for(size_t i = 0; i < prefix.size(); i++) {
+            if(foldCase(text[i]) != foldCase(prefix[i])) return false;
+        }
+        return true;
+    }
+
+    // Interned names share storage, so equal suffixes usually share an address.
+    static bool entryLess(const Entry& a, const Entry& b) {
+        if(a.text.data() != b.text.data() || a.text.size() != b.text.size()) {
+            int order = compareFolded(a.text, b.text);
+            if(order != 0) return order < 0;
+        }
+        return a.handle.slot < b.handle.slot;
+    }
+
+    template <typename Live>
+    static void dropDead(vector<Entry>& entries, Live live) {
+        entries.erase(remove_if(entries.begin(), entries.end(), [&](const Entry& entry) {
+            return entry.handle.generation == removedGeneration || !live(entry.handle);
+        }), entries.end());
+    }
+
+    // Merges the buffered inserts; pending entries whose employee is already
+    // gone never reach the sorted array.
+    template <typename Live>
+    void mergePending(Live live) const {
+        if(removed * 4 > sorted.size()) {
+            prune(live);
+            return;
+        }
+        if(pending.empty()) return;
+        AllocScope scope(AllocCategory::Index);
+        dropDead(pending, live);
+        sort(pending.begin(), pending.end(), entryLess);
+        size_t middle = sorted.size();
+        sorted.reserve(middle + pending.size());
+        sorted.insert(sorted.end(), pending.begin(), pending.end());
+        inplace_merge(sorted.begin(), sorted.begin() + middle, sorted.end(), entryLess);
+        if(pending.capacity() > 2 * minMergeBatch) vector<Entry>().swap(pending);
+        else pending.clear();
+    }
+
+public:
+    template <typename Live>
+    void insert(string_view name, EmployeeHandle handle, Live live) {
+        AllocScope scope(AllocCategory::Index);
+        for(size_t i = 0; i < name.size(); i++) {
+            if(i == 0 || name[i - 1] == ' ') pending.push_back({ name.substr(i), handle });
+        }
+        if(pending.size() >= minMergeBatch && pending.size() * 8 >= sorted.size()) mergePending(live);
+    }
+
+    // Marks the sorted entries of handle dead. Entries still pending are
+    // filtered by the live check when they are merged.
+    void remove(string_view name, EmployeeHandle handle) {
+        for(size_t i = 0; i < name.size(); i++) {
+            if(i != 0 && name[i - 1] != ' ') continue;
+            auto range = equal_range(sorted.begin(), sorted.end(), Entry{ name.substr(i), handle }, entryLess);
+            for(auto it = range.first; it != range.second; ++it) {
+                if(it->handle != handle) continue;
+                it->handle.generation = removedGeneration;
+                removed++;
+                break;
+            }
+        }
+    }
+
+    // Drops marked and stale entries and merges what is pending.
+    template <typename Live>
+    void prune(Live live) const {
+        AllocScope scope(AllocCategory::Index);
+        dropDead(sorted, live);
+        removed = 0;
+        if(sorted.capacity() > 2 * sorted.size()) sorted.shrink_to_fit();
+        mergePending(live);
+    }
+
+    // Slots whose name or any later word starts with prefix, ascending, without
+    // duplicates. A non-zero limit stops after that many distinct slots.
+    // live(handle) filters entries left behind by removed employees.
+    template <typename Live>
+    vector<uint32_t> find(string_view prefix, size_t limit, Live live) const {
+        mergePending(live);
+        vector<uint32_t> slots;
+        auto it = lower_bound(sorted.begin(), sorted.end(), prefix,
+            [](const Entry& entry, string_view key) { return lessFolded(entry.text, key); });
+        for(; it != sorted.end() && startsWithFolded(it->text, prefix); ++it) {
+            if(it->handle.generation == removedGeneration || !live(it->handle)) continue;
+            slots.push_back(it->handle.slot);
+            if(limit > 0 && slots.size() >= limit * 2) {
+                sort(slots.begin(), slots.end());
+                slots.erase(unique(slots.begin(), slots.end()), slots.end());
+                if(slots.size() >= limit) break;
+            }
+        }
+        sort(slots.begin(), slots.end());
+        slots.erase(unique(slots.begin(), slots.end()), slots.end());
+        if(limit > 0 && slots.size() > limit) slots.resize(limit);
+        return slots;
+    }
+
+    size_t memoryBytes() const {
+        return (sorted.capacity() + pending.capacity()) * sizeof(Entry);
+    }
+};
+
+// Edit distance between two case-folded strings (single-row DP).
+int editDistance(string_view a, string_view b, vector<int>& row) {
+    row.resize(b.size() + 1);
+    for(size_t j = 0; j <= b.size(); j++) row[j] = static_cast<int>(j);
+    for(size_t i = 1; i <= a.size(); i++) {
+        int diagonal = row[0];
+        row[0] = static_cast<int>(i);
+        for(size_t j = 1; j <= b.size(); j++) {
+            int above = row[j];
+            int cost = foldCase(a[i - 1]) == foldCase(b[j - 1]) ? 0 : 1;
+            row[j] = min(min(row[j] + 1, row[j - 1] + 1), diagonal + cost);
+            diagonal = above;
+        }
+    }
+    return row[b.size()];
+}
+
+struct FuzzyMatch {
+    uint32_t slot;
+    int distance;
+    double score; // 1.0 is an exact (case-insensitive) match
+};
+
+// Trigram inverted index for typo-tolerant name search. Names are interned,
+// so the index is built over distinct names: each trigram's posting list
+// holds name ids in increasing order, and each name id maps to the handle
+// slots of the employees carrying it. Names left without employees stay in
+// the postings until they make up half the names, then the index is rebuilt.
+class TrigramIndex {
+    static constexpr size_t alphabet = 27; // space plus a-z
+    static constexpr size_t trigramCount = alphabet * alphabet * alphabet;
+
+    vector<vector<uint32_t>> postings;
+    vector<string_view> names;
+    vector<vector<uint32_t>> slotsByName;
+    unordered_map<const char*, uint32_t> nameIds; // interned names compare by address
+    vector<uint32_t> nameOfSlot;     // by handle slot
+    vector<uint32_t> positionOfSlot; // index of the slot in slotsByName
+    size_t deadNames = 0;
+
+    static size_t symbol(char c) {
+        char folded = foldCase(c);
+        return (folded >= 'a' && folded <= 'z') ? static_cast<size_t>(folded - 'a' + 1) : 0;
+    }
+
+    // Distinct trigrams of " text ", sorted.
+    static void trigramsOf(string_view text, vector<uint32_t>& out) {
+        out.clear();
+        size_t a = 0, b = 0;
+        for(size_t i = 0; i <= text.size(); i++) {
+            size_t c = i < text.size() ? symbol(text[i]) : 0;
+            if(i > 0 || c != 0) out.push_back(static_cast<uint32_t>((a * alphabet + b) * alphabet + c));
+            a = b;
+            b = c;
+        }
+        sort(out.begin(), out.end());
+        out.erase(unique(out.begin(), out.end()), out.end());
+    }
+
+public:
+    TrigramIndex() : postings(trigramCount) {}
+
+    void insert(string_view name, uint32_t slot) {
+        AllocScope scope(AllocCategory::Index);
+        if(slot >= nameOfSlot.size()) {
+            nameOfSlot.resize(slot + 1);
+            positionOfSlot.resize(slot + 1);
+        }
+        auto found = nameIds.find(name.data());
+        if(found != nameIds.end()) {
+            vector<uint32_t>& slots = slotsByName[found->second];
+            if(slots.empty()) deadNames--;
+            nameOfSlot[slot] = found->second;
+            positionOfSlot[slot] = static_cast<uint32_t>(slots.size());
+            slots.push_back(slot);
+            return;
+        }
+        uint32_t nameId = static_cast<uint32_t>(names.size());
+        nameIds.emplace(name.data(), nameId);
+        names.push_back(name);
+        slotsByName.push_back({ slot });
+        nameOfSlot[slot] = nameId;
+        positionOfSlot[slot] = 0;
+        vector<uint32_t> grams;
+        trigramsOf(name, grams);
+        for(uint32_t gram : grams) postings[gram].push_back(nameId);
+    }
+
+    void remove(uint32_t slot) {
+        vector<uint32_t>& slots = slotsByName[nameOfSlot[slot]];
+        uint32_t position = positionOfSlot[slot];
+        slots[position] = slots.back();
+        positionOfSlot[slots[position]] = position;
+        slots.pop_back();
+        if(slots.empty() && ++deadNames * 2 > names.size()) dropDeadNames();
+    }
+
+    // Renumbers the names that still have employees; order is kept, so the
+    // posting lists stay sorted.
+    void dropDeadNames() {
+        AllocScope scope(AllocCategory::Index);
+        vector<uint32_t> newId(names.size(), UINT32_MAX);
+        uint32_t next = 0;
+        for(uint32_t id = 0; id < names.size(); id++) {
+            if(slotsByName[id].empty()) {
+                nameIds.erase(names[id].data());
+                continue;
+            }
+            newId[id] = next;
+            if(next != id) {
+                names[next] = names[id];
+                slotsByName[next] = move(slotsByName[id]);
+                nameIds[names[next].data()] = next;
+                for(uint32_t slot : slotsByName[next]) nameOfSlot[slot] = next;
+            }
+            next++;
+        }
+        names.resize(next);
+        slotsByName.resize(next);
+        for(auto& posting : postings) {
+            size_t kept = 0;
+            for(uint32_t id : posting) {
+                if(newId[id] != UINT32_MAX) posting[kept++] = newId[id];
+            }
+            posting.resize(kept);
+        }
+        deadNames = 0;
+    }
+
+    // Best matches for query, highest score first. Candidates must share
+    // enough trigrams to be within a length-scaled edit distance; they are
+    // gathered by a k-way merge of the query's posting lists and re-ranked
+    // by edit distance against the whole name and against each word.
+    vector<FuzzyMatch> search(string_view query, size_t limit) const {
+        vector<FuzzyMatch> matches;
+        vector<uint32_t> grams;
+        trigramsOf(query, grams);
+        if(grams.empty() || limit == 0) return matches;
+
+        int maxEdits = max(1, static_cast<int>(query.size() / 4));
+        int threshold = max(1, static_cast<int>(grams.size()) - 3 * maxEdits);
+
+        // k-way merge: heap of (name id, list) cursors.
+        typedef pair<uint32_t, uint32_t> Cursor;
+        vector<Cursor> heap;
+        vector<size_t> positions(grams.size(), 0);
+        for(uint32_t i = 0; i < grams.size(); i++) {
+            if(!postings[grams[i]].empty()) heap.push_back({ postings[grams[i]][0], i });
+        }
+        auto later = [](const Cursor& a, const Cursor& b) { return a.first > b.first; };
+        make_heap(heap.begin(), heap.end(), later);
+
+        vector<int> dp;
+        struct Candidate {
+            uint32_t nameId;
+            int distance;
+            double score;
+        };
+        vector<Candidate> scored;
+        while(!heap.empty()) {
+            uint32_t nameId = heap.front().first;
+            int shared = 0;
+            while(!heap.empty() && heap.front().first == nameId) {
+                pop_heap(heap.begin(), heap.end(), later);
+                uint32_t list = heap.back().second;
+                heap.pop_back();
+                shared++;
+                const vector<uint32_t>& posting = postings[grams[list]];
+                if(++positions[list] < posting.size()) {
+                    heap.push_back({ posting[positions[list]], list });
+                    push_heap(heap.begin(), heap.end(), later);
+                }
+            }
+            if(shared < threshold || slotsByName[nameId].empty()) continue;
+
+            string_view name = names[nameId];
+            int distance = editDistance(query, name, dp);
+            size_t start = 0;
+            while(start < name.size()) {
+                size_t end = name.find(' ', start);
+                if(end == string_view::npos) end = name.size();
+                distance = min(distance, editDistance(query, name.substr(start, end - start), dp));
+                start = end + 1;
+            }
+            if(distance > maxEdits * 2) continue;
+            double longest = static_cast<double>(max(query.size(), name.size()));
+            scored.push_back({ nameId, distance, 1.0 - distance / longest });
+        }
+
+        sort(scored.begin(), scored.end(), [](const Candidate& a, const Candidate& b) {
+            if(a.distance != b.distance) return a.distance < b.distance;
+            if(a.score != b.score) return a.score > b.score;
+            return a.nameId < b.nameId;
+        });
+        for(const auto& candidate : scored) {
+            for(uint32_t slot : slotsByName[candidate.nameId]) {
+                if(matches.size() >= limit) return matches;
+                matches.push_back({ slot, candidate.distance, candidate.score });
+            }
+        }
+        return matches;
+    }
+
+    size_t distinctNames() const { return names.size() - deadNames; }
+
+    size_t memoryBytes() const {
+        size_t total = postings.capacity() * sizeof(vector<uint32_t>)
+                     + names.capacity() * sizeof(string_view)
+                     + slotsByName.capacity() * sizeof(vector<uint32_t>)
+                     + nameIds.bucket_count() * sizeof(void*)
+                     + nameIds.size() * (sizeof(const char*) + sizeof(uint32_t) + 2 * sizeof(void*))
+                     + (nameOfSlot.capacity() + positionOfSlot.capacity()) * sizeof(uint32_t);
+        for(const auto& posting : postings) total += posting.capacity() * sizeof(uint32_t);
+        for(const auto& slots : slotsByName) total += slots.capacity() * sizeof(uint32_t);
+        return total;
+    }
+};
+
+enum class ReportOrder { Insertion, SalaryDescending, SalaryAscending, IdAscending };
+
+// Slot map from handle slots to storage rows. Freed slots are reused with a
+// bumped generation, so stale handles never resolve to a newer employee.
+class HandleTable {
+    vector<uint32_t> rows;
+    vector<uint32_t> generations;
+    vector<uint32_t> freeSlots;
+
+public:
+    static constexpr uint32_t npos = ~0u;
+
+    uint32_t allocate(uint32_t row) {
+        AllocScope scope(AllocCategory::Index);
+        if(!freeSlots.empty()) {
+            uint32_t slot = freeSlots.back();
+            freeSlots.pop_back();
+            rows[slot] = row;
+            return slot;
+        }
+        rows.push_back(row);
+        generations.push_back(0);
+        return static_cast<uint32_t>(rows.size() - 1);
+    }
+
+    void release(uint32_t slot) {
+        AllocScope scope(AllocCategory::Index);
+        rows[slot] = npos;
+        generations[slot]++;
+        freeSlots.push_back(slot);
+    }
+
+    bool isValid(EmployeeHandle handle) const {
+        return handle.slot < rows.size() && generations[handle.slot] == handle.generation
+            && rows[handle.slot] != npos;
+    }
+
+    EmployeeHandle handleOf(uint32_t slot) const { return { slot, generations[slot] }; }
+    uint32_t rowOf(uint32_t slot) const { return rows[slot]; }
+    void relocate(uint32_t slot, uint32_t row) { rows[slot] = row; }
+
+    void reserve(size_t count) {
+        AllocScope scope(AllocCategory::Index);
+        rows.reserve(count);
+        generations.reserve(count);
+    }
+
+    size_t memoryBytes() const {
+        return (rows.capacity() + generations.capacity() + freeSlots.capacity()) * sizeof(uint32_t);
+    }
+};
+
+// Storage rows and every index over them. A row is a position in employees
+// (insertion order); removing an employee leaves a nullptr tombstone there
+// until compaction squeezes the rows together. Indexes refer to handle slots,
+// not rows, so compaction only rewrites the row vectors and the slot map.
+// The roster never owns the employees it points to.
+class Roster {
+public:
+    vector<Employee*> employees;
+    vector<uint32_t> rowSlots; // handle slot of each row
+    HandleTable handles;
+    IdIndex idIndex;
+    SalaryIndex salaryIndex;
+    RoaringBitmap typeIndex[static_cast<size_t>(EmployeeType::Count)];
+    NamePrefixIndex nameIndex;
+    TrigramIndex trigramIndex;
+    size_t deadCount = 0;
+
+    // Incremental compaction: live rows slide left over tombstones a bounded
+    // number of rows per step, in order. While it runs, rows in
+    // [compactWrite, compactRead) are all tombstones and are never refilled.
+    bool compacting = false;
+    size_t compactRead = 0;
+    size_t compactWrite = 0;
+
+    size_t liveCount() const { return employees.size() - deadCount; }
+
+    void reserve(size_t count) {
+        AllocScope scope(AllocCategory::Index);
+        employees.reserve(count);
+        rowSlots.reserve(count);
+        handles.reserve(count);
+        idIndex.reserve(count);
+    }
+
+    Employee* bySlot(uint32_t slot) const { return employees[handles.rowOf(slot)]; }
+
+    Employee* resolve(EmployeeHandle handle) const {
+        return handles.isValid(handle) ? bySlot(handle.slot) : nullptr;
+    }
+
+    // Appends emp, or refills row if that row is a tombstone.
+    uint32_t insert(Employee* emp, uint32_t row = HandleTable::npos) {
+        AllocScope scope(AllocCategory::Index);
+        bool refill = row < employees.size() && !employees[row]
+                   && !(compacting && row >= compactWrite && row < compactRead);
+        if(!refill) row = static_cast<uint32_t>(employees.size());
+        uint32_t slot = handles.allocate(row);
+        idIndex.insert(emp->getId(), slot);
+        salaryIndex.insert(emp->getSalary(), slot);
+        typeIndex[static_cast<size_t>(emp->getType())].add(slot);
+        nameIndex.insert(emp->getName(), handles.handleOf(slot),
+                         [this](EmployeeHandle handle) { return handles.isValid(handle); });
+        trigramIndex.insert(emp->getName(), slot);
+        if(refill) {
+            employees[row] = emp;
+            rowSlots[row] = slot;
+            deadCount--;
+        } else {
+            employees.push_back(emp);
+            rowSlots.push_back(slot);
+        }
+        return slot;
+    }
+
+    // Tombstones the row, frees the handle slot and returns the employee it held
+    // (nullptr if unknown).
+    Employee* remove(const EmployeeId& id) {
+        uint32_t slot = idIndex.find(id);
+        if(slot == IdIndex::npos) return nullptr;
+        uint32_t row = handles.rowOf(slot);
+        Employee* emp = employees[row];
+        idIndex.erase(id);
+        salaryIndex.erase(emp->getSalary(), slot);
+        typeIndex[static_cast<size_t>(emp->getType())].remove(slot);
+        nameIndex.remove(emp->getName(), handles.handleOf(slot));
+        trigramIndex.remove(slot);
+        handles.release(slot);
+        employees[row] = nullptr;
+        deadCount++;
+        return emp;
+    }
+
+    // Puts emp in the place of the employee with the same ID; returns the previous one.
+    Employee* replace(Employee* emp) {
+        uint32_t slot = idIndex.find(emp->getId());
+        if(slot == IdIndex::npos) return nullptr;
+        uint32_t row = handles.rowOf(slot);
+        Employee* previous = employees[row];
+        if(previous->getSalary() != emp->getSalary()) {
+            AllocScope scope(AllocCategory::Index);
+            salaryIndex.erase(previous->getSalary(), slot);
+            salaryIndex.insert(emp->getSalary(), slot);
+        }
+        employees[row] = emp;
+        return previous;
+    }
+
+    void startCompaction() {
+        compacting = true;
+        compactRead = compactWrite = 0;
+    }
+
+    // Visits up to rows rows, calling moved(from, to) for each live row that
+    // slides left; indexes are untouched. Once the end is reached the
+    // trailing tombstones are cut off, dead name entries are pruned and it
+    // returns true.
+    template <typename Moved>
+    bool compactStep(size_t rows, Moved moved) {
+        for(; rows > 0 && compactRead < employees.size(); rows--, compactRead++) {
+            Employee* emp = employees[compactRead];
+            if(!emp) continue;
+            if(compactRead != compactWrite) {
+                employees[compactWrite] = emp;
+                rowSlots[compactWrite] = rowSlots[compactRead];
+                handles.relocate(rowSlots[compactWrite], static_cast<uint32_t>(compactWrite));
+                employees[compactRead] = nullptr;
+                moved(compactRead, compactWrite);
+            }
+            compactWrite++;
+        }
+        if(compactRead < employees.size()) return false;
+        deadCount -= employees.size() - compactWrite;
+        employees.resize(compactWrite);
+        rowSlots.resize(compactWrite);
+        nameIndex.prune([this](EmployeeHandle handle) { return handles.isValid(handle); });
+        compacting = false;
+        return true;
+    }
+};
+
+// Neumaier-compensated sum: carries the rounding error of every addition, so
+// long sums stay accurate. Partial sums merged in a fixed order give the same
+// bits however the parts were computed. Needs strict IEEE arithmetic (no
+// -ffast-math).
+struct CompensatedSum {
+    double sum = 0.0;
+    double compensation = 0.0;
+
+    void add(double value) {
+        double next = sum + value;
+        if(fabs(sum) >= fabs(value)) compensation += (sum - next) + value;
+        else compensation += (value - next) + sum;
+        sum = next;
+    }
+
+    void add(const CompensatedSum& other) {
+        add(other.sum);
+        compensation += other.compensation;
+    }
+
+    double value() const { return sum + compensation; }
+};
+
+struct PayrollTotals {
+    CompensatedSum total;
+    CompensatedSum byType[static_cast<size_t>(EmployeeType::Count)];
+
+    void add(const PayrollTotals& other) {
+        total.add(other.total);
+        for(size_t t = 0; t < static_cast<size_t>(EmployeeType::Count); t++) byType[t].add(other.byType[t]);
+    }
+};
+
+// Memory a writer unlinked while snapshots may still reach it: replaced trie
+// nodes and removed or superseded employees. One list per published version
+// collects what the writer retires after publishing it; released is set when
+// that version's snapshot is dropped, and the writer frees lists oldest first.
+struct RetireList {
+    struct Item {
+        const void* ptr;
+        void (*destroy)(const void*);
+    };
+    vector<Item> items;
+    atomic<bool> released{false};
+
+    RetireList() {
+        AllocScope scope(AllocCategory::Index);
+        items.reserve(16); // a typical single-employee change retires about ten items
+    }
+
+    void add(const void* ptr, void (*destroy)(const void*)) {
+        AllocScope scope(AllocCategory::Index);
+        items.push_back({ ptr, destroy });
+    }
+
+    template <typename T>
+    void add(const T* ptr) {
+        add(ptr, [](const void* p) { delete static_cast<const T*>(p); });
+    }
+
+    ~RetireList() {
+        for(const Item& item : items) item.destroy(item.ptr);
+    }
+};
+
+// The version a writer is building and where it retires what it replaces.
+// Nodes stamped with that version are unpublished and edited in place.
+struct VersionEdit {
+    uint64_t version;
+    RetireList* retired;
+};
+
+// Persistent vector: a 32-way trie whose nodes are shared between versions.
+// Writers copy only the path they touch, so publishing a version costs
+// O(log32 n). The trie never frees nodes itself; see RetireList.
+template <typename T>
+class PersistentVector {
+    static constexpr int bits = 5;
+    static constexpr size_t width = 1 << bits;
+    static constexpr size_t mask = width - 1;
+
+    struct Leaf {
+        uint64_t version;
+        T items[width];
+    };
+    struct Branch {
+        uint64_t version;
+        void* children[width];
+    };
+
+    void* root = nullptr;
+    int shift = 0; // bits consumed above the leaves
+    size_t count = 0;
+
+    template <typename Node>
+    static Node* editable(void*& slot, const VersionEdit& edit) {
+        Node* node = static_cast<Node*>(slot);
+        if(node && node->version == edit.version) return node;
+        Node* copy = node ? new Node(*node) : new Node();
+        copy->version = edit.version;
+        if(node) edit.retired->add(node);
+        slot = copy;
+        return copy;
+    }
+
+    template <typename Node>
+    static void release(Node* node, const VersionEdit& edit) {
+        if(node->version == edit.version) delete node;
+        else edit.retired->add(node);
+    }
+
+    static void releaseTree(void* node, int level, const VersionEdit& edit) {
+        if(level == 0) {
+            release(static_cast<Leaf*>(node), edit);
+            return;
+        }
+        Branch* branch = static_cast<Branch*>(node);
+        for(void* child : branch->children) {
+            if(child) releaseTree(child, level - bits, edit);
+        }
+        release(branch, edit);
+    }
+
+    template <typename F>
+    static void visit(const void* node, int level, size_t& remaining, F& f) {
+        if(level == 0) {
+            const Leaf* leaf = static_cast<const Leaf*>(node);
+            for(size_t i = 0; i < width && remaining > 0; i++, remaining--) f(leaf->items[i]);
+            return;
+        }
+        const Branch* branch = static_cast<const Branch*>(node);
+        for(size_t i = 0; i < width && remaining > 0; i++) {
+            visit(branch->children[i], level - bits, remaining, f);
+        }
+    }
+
+public:
+    size_t size() const { return count; }
+
+    T get(size_t index) const {
+        const void* node = root;
+        for(int level = shift; level > 0; level -= bits) {
+            node = static_cast<const Branch*>(node)->children[(index >> level) & mask];
+        }
+        return static_cast<const Leaf*>(node)->items[index & mask];
+    }
+
+    void set(size_t index, T value, const VersionEdit& edit) {
+        AllocScope scope(AllocCategory::Index);
+        void** slot = &root;
+        for(int level = shift; level > 0; level -= bits) {
+            slot = &editable<Branch>(*slot, edit)->children[(index >> level) & mask];
+        }
+        editable<Leaf>(*slot, edit)->items[index & mask] = value;
+    }
+
+    void push_back(T value, const VersionEdit& edit) {
+        if(root && count == (width << shift)) {
+            AllocScope scope(AllocCategory::Index);
+            Branch* grown = new Branch();
+            grown->version = edit.version;
+            grown->children[0] = root;
+            root = grown;
+            shift += bits;
+        }
+        set(count++, value, edit);
+    }
+
+    // Drops the items from size on. Their nodes stay until later pushes
+    // overwrite them (copying any a snapshot still uses), so callers clear
+    // the items first rather than leave pointers there.
+    void truncate(size_t size) {
+        if(size < count) count = size;
+    }
+
+    // Empties the vector, retiring every node a snapshot may still use.
+    void clear(const VersionEdit& edit) {
+        if(root) releaseTree(root, shift, edit);
+        root = nullptr;
+        shift = 0;
+        count = 0;
+    }
+
+    template <typename F>
+    void forEach(F f) const {
+        size_t remaining = count;
+        if(root) visit(root, shift, remaining, f);
+    }
+
+    // Visits [begin, end) a leaf at a time; lets callers split the work.
+    template <typename F>
+    void forEachInRange(size_t begin, size_t end, F f) const {
+        for(size_t index = begin; index < end;) {
+            const void* node = root;
+            for(int level = shift; level > 0; level -= bits) {
+                node = static_cast<const Branch*>(node)->children[(index >> level) & mask];
+            }
+            const Leaf* leaf = static_cast<const Leaf*>(node);
+            size_t stop = min(end, (index | mask) + 1);
+            for(; index < stop; index++) f(leaf->items[index & mask]);
+        }
+    }
+};
+
+// Persistent hash array mapped trie from a 64-bit key to a value, 5 hash bits
+// per level, entries packed after each node header by bitmap popcount.
+// mixBits is a bijection, so distinct keys never fully collide and no
+// collision buckets are needed. Same versioning rules as PersistentVector.
+template <typename T>
+class PersistentIdMap {
+    struct Node;
+    struct Entry {
+        uint64_t key;
+        T value;
+        Node* child; // set for entries that are subtrees
+    };
+    struct Node {
+        uint64_t version;
+        uint32_t bitmap;
+        uint16_t size;
+        uint16_t capacity;
+
+        Entry* entries() { return reinterpret_cast<Entry*>(this + 1); }
+        const Entry* entries() const { return reinterpret_cast<const Entry*>(this + 1); }
+    };
+
+    Node* root = nullptr;
+    size_t count = 0;
+
+    static uint32_t bitFor(uint64_t hash, int shift) { return 1u << ((hash >> shift) & 31); }
+    static size_t indexFor(uint32_t bitmap, uint32_t bit) { return __builtin_popcount(bitmap & (bit - 1)); }
+
+    static Node* allocate(size_t capacity, uint64_t version) {
+        Node* node = static_cast<Node*>(::operator new(sizeof(Node) + capacity * sizeof(Entry)));
+        node->version = version;
+        node->bitmap = 0;
+        node->size = 0;
+        node->capacity = static_cast<uint16_t>(capacity);
+        return node;
+    }
+
+    static void destroy(const void* node) { ::operator delete(const_cast<void*>(node)); }
+
+    static void release(Node* node, const VersionEdit& edit) {
+        if(node->version == edit.version) destroy(node);
+        else edit.retired->add(node, destroy);
+    }
+
+    static void releaseTree(Node* node, const VersionEdit& edit) {
+        for(size_t i = 0; i < node->size; i++) {
+            if(node->entries()[i].child) releaseTree(node->entries()[i].child, edit);
+        }
+        release(node, edit);
+    }
+
+    // A node in *slot the writer may edit, with room for capacity entries.
+    static Node* editable(Node*& slot, size_t capacity, const VersionEdit& edit) {
+        Node* node = slot;
+        if(node && node->version == edit.version && node->capacity >= capacity) return node;
+        size_t room = capacity;
+        if(node && node->version == edit.version) room = min<size_t>(32, max<size_t>(capacity, node->capacity * 2));
+        Node* copy = allocate(room, edit.version);
+        if(node) {
+            copy->bitmap = node->bitmap;
+            copy->size = node->size;
+            memcpy(copy->entries(), node->entries(), node->size * sizeof(Entry));
+            release(node, edit);
+        }
+        slot = copy;
+        return copy;
+    }
+
+    bool assignIn(Node*& slot, uint64_t key, uint64_t hash, int shift, T value, const VersionEdit& edit) {
+        uint32_t bit = bitFor(hash, shift);
+        if(!slot || !(slot->bitmap & bit)) {
+            Node* node = editable(slot, (slot ? slot->size : 0) + 1, edit);
+            size_t index = indexFor(node->bitmap, bit);
+            Entry* entries = node->entries();
+            memmove(entries + index + 1, entries + index, (node->size - index) * sizeof(Entry));
+            entries[index] = { key, value, nullptr };
+            node->bitmap |= bit;
+            node->size++;
+            return true;
+        }
+        Node* node = editable(slot, slot->size, edit);
+        Entry& entry = node->entries()[indexFor(node->bitmap, bit)];
+        if(!entry.child) {
+            if(entry.key == key) {
+                entry.value = value;
+                return false;
+            }
+            // Push the resident entry one level down and retry there.
+            Node* child = allocate(2, edit.version);
+            child->bitmap = bitFor(mixBits(entry.key), shift + 5);
+            child->size = 1;
+            child->entries()[0] = { entry.key, entry.value, nullptr };
+            entry.child = child;
+        }
+        return assignIn(entry.child, key, hash, shift + 5, value, edit);
+    }
+
+    bool eraseIn(Node*& slot, uint64_t key, uint64_t hash, int shift, const VersionEdit& edit) {
+        uint32_t bit = bitFor(hash, shift);
+        if(!slot || !(slot->bitmap & bit)) return false;
+        size_t index = indexFor(slot->bitmap, bit);
+        const Entry& found = slot->entries()[index];
+        if(!found.child && found.key != key) return false;
+        Node* node = editable(slot, slot->size, edit);
+        Entry* entries = node->entries();
+        if(entries[index].child) {
+            if(!eraseIn(entries[index].child, key, hash, shift + 5, edit)) return false;
+            if(entries[index].child->size > 0) return true;
+            release(entries[index].child, edit);
+        }
+        memmove(entries + index, entries + index + 1, (node->size - index - 1) * sizeof(Entry));
+        node->bitmap &= ~bit;
+        node->size--;
+        return true;
+    }
+
+public:
+    size_t size() const { return count; }
+
+    bool find(uint64_t key, T& value) const {
+        uint64_t hash = mixBits(key);
+        const Node* node = root;
+        for(int shift = 0; node; shift += 5) {
+            uint32_t bit = bitFor(hash, shift);
+            if(!(node->bitmap & bit)) return false;
+            const Entry& entry = node->entries()[indexFor(node->bitmap, bit)];
+            if(!entry.child) {
+                if(entry.key != key) return false;
+                value = entry.value;
+                return true;
+            }
+            node = entry.child;
+        }
+        return false;
+    }
+
+    void assign(uint64_t key, T value, const VersionEdit& edit) {
+        AllocScope scope(AllocCategory::Index);
+        if(assignIn(root, key, mixBits(key), 0, value, edit)) count++;
+    }
+
+    bool erase(uint64_t key, const VersionEdit& edit) {
+        AllocScope scope(AllocCategory::Index);
+        if(!eraseIn(root, key, mixBits(key), 0, edit)) return false;
+        count--;
+        return true;
+    }
+
+    void clear(const VersionEdit& edit) {
+        if(root) releaseTree(root, edit);
+        root = nullptr;
+        count = 0;
+    }
+};
+
+// Immutable view of the roster at one published version. Readers on any
+// thread use it without locks; the employees it points to stay alive for as
+// long as the snapshot does. Snapshots must be dropped before their
+// PayrollSystem is destroyed.
+class RosterSnapshot {
+public:
+    PersistentVector<const Employee*> rows; // insertion order, nullptr for removed rows
+    PersistentIdMap<const Employee*> byId;
+    size_t typeCounts[static_cast<size_t>(EmployeeType::Count)] = {};
+    uint64_t version = 0;
+
+    const Employee* find(const EmployeeId& id) const {
+        const Employee* emp = nullptr;
+        byId.find(id.raw(), emp);
+        return emp;
+    }
+
+    size_t employeeCount() const { return byId.size(); }
+
+    size_t employeeCount(EmployeeType type) const { return typeCounts[static_cast<size_t>(type)]; }
+
+    // Rows per task when a scheduler is given; smaller snapshots stay serial.
+    static constexpr size_t parallelGrain = 16384;
+
+    // Reduces fixed chunks of parallelGrain rows and merges the partials in
+    // chunk order, so the result has the same bits serially or on any number
+    // of workers.
+    template <typename Partial, typename Map>
+    Partial reduceRows(TaskScheduler* tasks, Map map) const {
+        if(tasks && rows.size() > parallelGrain) {
+            return tasks->parallelReduce(size_t(0), rows.size(), parallelGrain, Partial(), map,
+                [](Partial merged, const Partial& part) { merged.add(part); return merged; });
+        }
+        Partial merged;
+        for(size_t begin = 0; begin < rows.size(); begin += parallelGrain) {
+            merged.add(map(begin, min(rows.size(), begin + parallelGrain)));
+        }
+        return merged;
+    }
+
+    double totalPayroll(TaskScheduler* tasks = nullptr) const {
+        return reduceRows<CompensatedSum>(tasks, [this](size_t begin, size_t end) {
+            CompensatedSum total;
+            rows.forEachInRange(begin, end, [&](const Employee* emp) { if(emp) total.add(emp->getSalary()); });
+            return total;
+        }).value();
+    }
+
+    // Overall and per-type totals in one pass; the overall total has the same
+    // bits as totalPayroll().
+    PayrollTotals payrollTotals(TaskScheduler* tasks = nullptr) const {
+        return reduceRows<PayrollTotals>(tasks, [this](size_t begin, size_t end) {
+            PayrollTotals totals;
+            rows.forEachInRange(begin, end, [&](const Employee* emp) {
+                if(!emp) return;
+                totals.total.add(emp->getSalary());
+                totals.byType[static_cast<size_t>(emp->getType())].add(emp->getSalary());
+            });
+            return totals;
+        });
+    }
+
+    void renderPayrollReport(string& out, TaskScheduler* tasks = nullptr) const {
+        AllocScope scope(AllocCategory::Report);
+        out.clear();
+        if(employeeCount() == 0) {
+            out += "No employees in system!\n\n";
+            return;
+        }
+        out += "\nEmployee Payroll Report ---\n";
+        if(!tasks || rows.size() <= parallelGrain) {
+            rows.forEach([&](const Employee* emp) { if(emp) emp->render(out); });
+            return;
+        }
+        // Chunks render into their own buffers and are stitched in row order.
+        vector<string> parts((rows.size() + parallelGrain - 1) / parallelGrain);
+        tasks->parallelFor(0, parts.size(), 1, [&](size_t first, size_t last) {
+            AllocScope taskScope(AllocCategory::Report);
+            for(size_t c = first; c < last; c++) {
+                rows.forEachInRange(c * parallelGrain, min(rows.size(), (c + 1) * parallelGrain),
+                    [&](const Employee* emp) { if(emp) emp->render(parts[c]); });
+            }
+        });
+        size_t length = out.size();
+        for(const string& part : parts) length += part.size();
+        out.reserve(length);
+        for(const string& part : parts) out += part;
+    }
+};
+
+// What-if view of a snapshot's pay: per employment type, a rate column
+// (monthly salary, hourly rate or payment per project) and a quantity column
+// (1, hours worked or projects completed), with salary = rate * quantity.
+// Columns are cut into fixed chunks. Copying a scenario forks it in
+// O(chunks): the copy shares every chunk and clones one only when it first
+// writes to it, so adjustments never touch the roster or other forks.
+class PayrollScenario {
+public:
+    enum class Column { Rate, Quantity };
+
+    static constexpr size_t chunkRows = 16384;
+
+private:
+    static constexpr size_t typeCount = static_cast<size_t>(EmployeeType::Count);
+    static constexpr size_t columnCount = 2;
+
+    // Shared by every fork of one snapshot. Holds no employees, so a cached
+    // scenario does not keep old versions alive.
+    struct Base {
+        uint64_t version;
+        vector<pair<uint64_t, uint32_t>> positions; // sorted by packed ID; type in the top two bits
+    };
+
+    struct ColumnChunks {
+        vector<shared_ptr<vector<double>>> chunks;
+        vector<bool> owned; // chunks this fork may write in place
+    };
+
+    shared_ptr<const Base> base;
+    ColumnChunks columns[typeCount][columnCount];
+    size_t rowCounts[typeCount] = {};
+
+    vector<double>& writable(size_t type, Column column, size_t chunk) {
+        ColumnChunks& target = columns[type][static_cast<size_t>(column)];
+        if(!target.owned[chunk]) {
+            AllocScope scope(AllocCategory::Index);
+            target.chunks[chunk] = make_shared<vector<double>>(*target.chunks[chunk]);
+            target.owned[chunk] = true;
+        }
+        return *target.chunks[chunk];
+    }
+
+    // Sum of rate * quantity over one chunk. Four fixed lanes let the loop
+    // vectorize and keep the result independent of who runs it.
+    static double chunkTotal(const vector<double>& rates, const vector<double>& quantities) {
+        double lanes[4] = {};
+        size_t n = rates.size(), i = 0;
+        for(; i + 4 <= n; i += 4) {
+            for(size_t k = 0; k < 4; k++) lanes[k] += rates[i + k] * quantities[i + k];
+        }
+        for(; i < n; i++) lanes[0] += rates[i] * quantities[i];
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+
+public:
+    // Builds the columns from snap in O(n); fork it by copying.
+    explicit PayrollScenario(const RosterSnapshot& snap) {
+        AllocScope scope(AllocCategory::Index);
+        auto built = make_shared<Base>();
+        built->version = snap.version;
+        built->positions.reserve(snap.employeeCount());
+        snap.rows.forEach([&](const Employee* emp) {
+            if(!emp) return;
+            size_t type = static_cast<size_t>(emp->getType());
+            double rate = emp->getSalary(), quantity = 1.0;
+            if(emp->getType() == EmployeeType::PartTime) {
+                const auto* partTime = static_cast<const PartTimeEmployee*>(emp);
+                rate = partTime->getHourlyRate();
+                quantity = partTime->getHoursWorked();
+            } else if(emp->getType() == EmployeeType::Contractual) {
+                const auto* contractual = static_cast<const ContractualEmployee*>(emp);
+                rate = contractual->getPaymentPerProject();
+                quantity = contractual->getProjectsCompleted();
+            }
+            size_t index = rowCounts[type]++;
+            if(index % chunkRows == 0) {
+                for(auto& column : columns[type]) {
+                    column.chunks.push_back(make_shared<vector<double>>());
+                    column.chunks.back()->reserve(chunkRows);
+                    column.owned.push_back(true);
+                }
+            }
+            columns[type][0].chunks.back()->push_back(rate);
+            columns[type][1].chunks.back()->push_back(quantity);
+            built->positions.push_back({ emp->getId().raw(), static_cast<uint32_t>(type << 30 | index) });
+        });
+        sort(built->positions.begin(), built->positions.end());
+        base = std::move(built);
+    }
+
+    PayrollScenario(const PayrollScenario& other) : base(other.base) {
+        AllocScope scope(AllocCategory::Index);
+        for(size_t t = 0; t < typeCount; t++) {
+            rowCounts[t] = other.rowCounts[t];
+            for(size_t c = 0; c < columnCount; c++) {
+                columns[t][c].chunks = other.columns[t][c].chunks;
+                columns[t][c].owned.assign(columns[t][c].chunks.size(), false);
+            }
+        }
+    }
+
+    PayrollScenario& operator=(const PayrollScenario&) = delete;
+
+    uint64_t version() const { return base->version; }
+
+    // Applies f to one column of every employee of type.
+    template <typename F>
+    void transform(EmployeeType type, Column column, F f) {
+        size_t t = static_cast<size_t>(type);
+        for(size_t chunk = 0; chunk < columns[t][static_cast<size_t>(column)].chunks.size(); chunk++) {
+            for(double& value : writable(t, column, chunk)) value = f(value);
+        }
+    }
+
+    void scale(EmployeeType type, Column column, double factor) {
+        transform(type, column, [factor](double value) { return value * factor; });
+    }
+
+    void add(EmployeeType type, Column column, double amount) {
+        transform(type, column, [amount](double value) { return value + amount; });
+    }
+
+    void clamp(EmployeeType type, Column column, double low, double high) {
+        transform(type, column, [low, high](double value) { return min(max(value, low), high); });
+    }
+
+    // Overrides one employee's value; false if the ID was not in the snapshot.
+    bool set(const EmployeeId& id, Column column, double value) {
+        const auto& positions = base->positions;
+        auto found = lower_bound(positions.begin(), positions.end(), make_pair(id.raw(), uint32_t(0)));
+        if(found == positions.end() || found->first != id.raw()) return false;
+        size_t type = found->second >> 30, index = found->second & ((1u << 30) - 1);
+        writable(type, column, index / chunkRows)[index % chunkRows] = value;
+        return true;
+    }
+
+    // One task per chunk; partials merge in type and chunk order, so the
+    // totals have the same bits serially or on any number of workers.
+    PayrollTotals totals(TaskScheduler* tasks = nullptr) const {
+        vector<pair<size_t, size_t>> work; // (type, chunk)
+        for(size_t t = 0; t < typeCount; t++) {
+            for(size_t chunk = 0; chunk < columns[t][0].chunks.size(); chunk++) work.push_back({ t, chunk });
+        }
+        auto map = [&](size_t first, size_t last) {
+            PayrollTotals partial;
+            for(size_t w = first; w < last; w++) {
+                size_t t = work[w].first, chunk = work[w].second;
+                double sum = chunkTotal(*columns[t][0].chunks[chunk], *columns[t][1].chunks[chunk]);
+                partial.total.add(sum);
+                partial.byType[t].add(sum);
+            }
+            return partial;
+        };
+        if(tasks && work.size() > 1) {
+            return tasks->parallelReduce(size_t(0), work.size(), 1, PayrollTotals(), map,
+                [](PayrollTotals merged, const PayrollTotals& part) { merged.add(part); return merged; });
+        }
+        PayrollTotals merged;
+        for(size_t w = 0; w < work.size(); w++) merged.add(map(w, w + 1));
+        return merged;
+    }
+
+    // Visits type's columns a chunk at a time: f(rates, quantities).
+    template <typename F>
+    void forEachChunk(EmployeeType type, F f) const {
+        size_t t = static_cast<size_t>(type);
+        for(size_t chunk = 0; chunk < columns[t][0].chunks.size(); chunk++) {
+            f(*columns[t][0].chunks[chunk], *columns[t][1].chunks[chunk]);
+        }
+    }
+
+    size_t employeeCount(EmployeeType type) const { return rowCounts[static_cast<size_t>(type)]; }
+
+    // Chunks this fork has copied so far, against all it can see.
+    size_t ownedChunks() const {
+        size_t owned = 0;
+        for(const auto& type : columns) {
+            for(const auto& column : type) owned += count(column.owned.begin(), column.owned.end(), true);
+        }
+        return owned;
+    }
+
+    size_t chunkCount() const {
+        size_t total = 0;
+        for(const auto& type : columns) {
+            for(const auto& column : type) total += column.chunks.size();
+        }
+        return total;
+    }
+};
+
+// Monte Carlo budget forecast. Each trial simulates periods monthly pay
+// periods: full-time salaries are fixed, while part-time hours and contract
+// project counts vary per employee and period around their current values
+// (continuous, normal-like, never below zero).
+struct ProjectionModel {
+    size_t trials = 2000;
+    size_t periods = 12;
+    double hoursVariation = 0.15;   // relative standard deviation per period
+    double projectVariation = 0.30;
+    uint64_t seed = 1;
+};
+
+struct ProjectionResult {
+    static constexpr double levels[5] = { 5, 25, 50, 75, 95 };
+    double percentiles[5]; // total cost per trial at each level
+    double mean;
+    size_t employeePeriods; // simulated (part-time and contractual) only
+};
+
+// Draws come from a counter-based generator: the value for (trial, period,
+// employee) is a hash of those numbers, so any thread can produce any draw
+// and results do not depend on how trials are spread over workers.
+inline uint64_t projectionStream(uint64_t seed, size_t trial, size_t period, EmployeeType type) {
+    return mixBits(seed ^ mixBits((uint64_t(trial) << 24) ^ (uint64_t(period) << 4) ^ uint64_t(type)));
+}
+
+// 32-bit avalanche hash (lowbias32). Unlike mixBits it needs only 32-bit
+// multiplies, so loops over it vectorize on plain SSE2.
+inline uint32_t hash32(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// Sum over one chunk of rate * max(0, quantity * (1 + variation * z)). z
+// sums four 16-bit uniforms from two hashes of the employee's counter
+// (Irwin-Hall, scaled to unit variance). Draws are computed a block at a
+// time in a branch-free loop the compiler vectorizes, then summed in four
+// fixed lanes so the result does not depend on who runs it.
+inline double simulateChunk(const vector<double>& rates, const vector<double>& quantities,
+                            double variation, uint64_t stream, size_t first) {
+    const size_t block = 256;
+    const double unit = 1.0 / 65536.0, scale = sqrt(3.0) * variation;
+    const uint32_t low = uint32_t(stream), high = uint32_t(stream >> 32);
+    auto cost = [&](size_t i) {
+        uint32_t counter = uint32_t(first + i);
+        uint32_t a = hash32(low ^ counter), b = hash32(high ^ counter);
+        double u = double(int32_t(a & 0xffff)) + double(int32_t(a >> 16))
+                 + double(int32_t(b & 0xffff)) + double(int32_t(b >> 16));
+        double z = (u + 2.0) * unit - 2.0;
+        return rates[i] * max(0.0, quantities[i] * (1.0 + scale * z));
+    };
+    double costs[block];
+    double lanes[4] = {};
+    size_t start = 0;
+    // A fixed trip count keeps the inner loop within what -O2 vectorizes.
+    for(; start + block <= rates.size(); start += block) {
+        for(size_t k = 0; k < block; k++) costs[k] = cost(start + k);
+        for(size_t k = 0; k < block; k++) lanes[k & 3] += costs[k];
+    }
+    for(size_t i = start; i < rates.size(); i++) lanes[(i - start) & 3] += cost(i);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+// Runs model.trials trials over the scenario's pay columns, one task per trial.
+ProjectionResult projectPayroll(const PayrollScenario& scenario, const ProjectionModel& model,
+                                TaskScheduler* tasks = nullptr) {
+    AllocScope scope(AllocCategory::Report);
+    PayrollTotals current = scenario.totals();
+    double fixed = current.byType[static_cast<size_t>(EmployeeType::FullTime)].value() * model.periods;
+    vector<double> trialTotals(model.trials);
+    auto simulate = [&](size_t first, size_t last) {
+        for(size_t trial = first; trial < last; trial++) {
+            CompensatedSum total;
+            total.add(fixed);
+            for(size_t period = 0; period < model.periods; period++) {
+                for(EmployeeType type : { EmployeeType::PartTime, EmployeeType::Contractual }) {
+                    double variation = type == EmployeeType::PartTime ? model.hoursVariation : model.projectVariation;
+                    uint64_t stream = projectionStream(model.seed, trial, period, type);
+                    size_t offset = 0;
+                    scenario.forEachChunk(type, [&](const vector<double>& rates, const vector<double>& quantities) {
+                        total.add(simulateChunk(rates, quantities, variation, stream, offset));
+                        offset += rates.size();
+                    });
+                }
+            }
+            trialTotals[trial] = total.value();
+        }
+    };
+    if(tasks) tasks->parallelFor(0, model.trials, 1, simulate);
+    else simulate(0, model.trials);
+
+    ProjectionResult result = {};
+    result.employeePeriods = model.trials * model.periods
+        * (scenario.employeeCount(EmployeeType::PartTime) + scenario.employeeCount(EmployeeType::Contractual));
+    if(trialTotals.empty()) return result;
+    CompensatedSum sum;
+    for(double total : trialTotals) sum.add(total);
+    result.mean = sum.value() / trialTotals.size();
+    sort(trialTotals.begin(), trialTotals.end());
+    for(size_t i = 0; i < 5; i++) {
+        // Nearest rank.
+        size_t rank = size_t(ceil(ProjectionResult::levels[i] / 100.0 * trialTotals.size()));
+        result.percentiles[i] = trialTotals[rank > 0 ? rank - 1 : 0];
+    }
+    return result;
+}
+
+// Pay history in columns, one row per run: consecutive periods in which an
+// employee was paid the same amount. A steady salary costs one row however
+// many periods it covers; rows are added only when pay changes or an
+// employee starts or comes back. Amounts are whole cents so totals are exact.
+class PayHistory {
+    vector<uint32_t> runStarts;
+    vector<uint32_t> runLengths;
+    vector<int64_t> runCents;    // paid in each period of the run
+    vector<uint32_t> previousRuns; // the employee's earlier run, or npos
+    IdIndex latestRun;
+    uint32_t nextPeriod = 0;
+    size_t periodCount = 0;
+    size_t employeePeriods = 0;
+
+    void append(const EmployeeId& id, uint32_t period, int64_t cents) {
+        employeePeriods++;
+        uint32_t run = latestRun.find(id);
+        if(run != npos && runStarts[run] + runLengths[run] == period && runCents[run] == cents) {
+            runLengths[run]++;
+            return;
+        }
+        latestRun.assign(id, static_cast<uint32_t>(runStarts.size()));
+        runStarts.push_back(period);
+        runLengths.push_back(1);
+        runCents.push_back(cents);
+        previousRuns.push_back(run);
+    }
+
+public:
+    static constexpr uint32_t npos = ~0u;
+
+    static int64_t toCents(double amount) { return llround(amount * 100.0); }
+
+    uint32_t upcomingPeriod() const { return nextPeriod; }
+    size_t periodsRecorded() const { return periodCount; }
+    size_t runCount() const { return runStarts.size(); }
+    size_t payments() const { return employeePeriods; }
+
+    // Pays everyone in snap for period in one pass over its rows. Periods
+    // only move forward; false if period was already passed.
+    bool record(uint32_t period, const RosterSnapshot& snap) {
+        if(period < nextPeriod) return false;
+        AllocScope scope(AllocCategory::Index);
+        snap.rows.forEach([&](const Employee* emp) {
+            if(emp) append(emp->getId(), period, toCents(emp->getSalary()));
+        });
+        nextPeriod = period + 1;
+        periodCount++;
+        return true;
+    }
+
+    // Cents paid in each period of [from, to). Each run adds its amount at
+    // its first period and takes it off after its last (a difference array),
+    // so the work is one sequential pass over three columns plus a prefix
+    // sum; with a scheduler, ranges of runs fill private arrays that are
+    // added up after. Integer cents make the result exact in any order.
+    vector<int64_t> totalsByPeriod(uint32_t from, uint32_t to, TaskScheduler* tasks = nullptr) const {
+        if(to <= from) return {};
+        size_t span = to - from;
+        auto scan = [&](size_t first, size_t last) {
+            vector<int64_t> diff(span + 1);
+            for(size_t r = first; r < last; r++) {
+                // Clamped without branches; runs outside the window add and
+                // remove their amount in the same place.
+                uint32_t start = min(max(runStarts[r], from), to);
+                uint32_t end = max(min(runStarts[r] + runLengths[r], to), start);
+                diff[start - from] += runCents[r];
+                diff[end - from] -= runCents[r];
+            }
+            return diff;
+        };
+        const size_t grain = 1 << 16;
+        vector<int64_t> diff = tasks && runStarts.size() > grain
+            ? tasks->parallelReduce(size_t(0), runStarts.size(), grain, vector<int64_t>(span + 1), scan,
+                [](vector<int64_t> merged, const vector<int64_t>& part) {
+                    for(size_t i = 0; i < part.size(); i++) merged[i] += part[i];
+                    return merged;
+                })
+            : scan(0, runStarts.size());
+        vector<int64_t> totals(span);
+        int64_t running = 0;
+        for(size_t p = 0; p < span; p++) totals[p] = running += diff[p];
+        return totals;
+    }
+
+    // Cents paid to id over [from, to), following its runs newest first.
+    int64_t paidTo(const EmployeeId& id, uint32_t from, uint32_t to) const {
+        int64_t total = 0;
+        forEachRun(id, [&](uint32_t start, uint32_t length, int64_t cents) {
+            uint32_t first = max(start, from), last = min(start + length, to);
+            if(first < last) total += cents * (last - first);
+        });
+        return total;
+    }
+
+    // f(start, length, cents) for each of id's runs, newest first.
+    template <typename F>
+    void forEachRun(const EmployeeId& id, F f) const {
+        for(uint32_t run = latestRun.find(id); run != npos; run = previousRuns[run]) {
+            f(runStarts[run], runLengths[run], runCents[run]);
+        }
+    }
+
+    size_t memoryBytes() const {
+        return runStarts.capacity() * sizeof(uint32_t)
+             + runLengths.capacity() * sizeof(uint32_t) + runCents.capacity() * sizeof(int64_t)
+             + previousRuns.capacity() * sizeof(uint32_t) + latestRun.memoryBytes();
+    }
+};
+
+// Streams a text file through one buffer of chunkBytes, passing consume
+// only whole lines (the last one may lack its newline). A partial line at
+// the end of a read is carried into the next. False if the file cannot be
+// read; bytes counts what was.
+template <typename Consume>
+bool forEachLineChunk(const string& path, size_t chunkBytes, size_t& bytes, Consume consume) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if(!file) return false;
+    vector<char> buffer;
+    {
+        AllocScope scope(AllocCategory::Input);
+        buffer.resize(chunkBytes);
+    }
+    size_t carried = 0;
+    while(true) {
+        if(carried == buffer.size()) {
+            AllocScope scope(AllocCategory::Input);
+            buffer.resize(buffer.size() * 2); // a line longer than the buffer
+        }
+        size_t read = fread(buffer.data() + carried, 1, buffer.size() - carried, file);
+        bytes += read;
+        size_t filled = carried + read;
+        if(read == 0) {
+            if(filled > 0) consume(buffer.data(), buffer.data() + filled);
+            break;
+        }
+        size_t complete = filled;
+        while(complete > 0 && buffer[complete - 1] != '\n') complete--;
+        if(complete > 0) consume(buffer.data(), buffer.data() + complete);
+        carried = filled - complete;
+        memmove(buffer.data(), buffer.data() + complete, carried);
+    }
+    bool failed = ferror(file) != 0;
+    fclose(file);
+    return !failed;
+}
+
+// Hours per employee from clock-in/clock-out logs, one "ID,IN,seconds" or
+// "ID,OUT,seconds" line per event. The file is read in large chunks. Each
+// chunk is parsed in segments that scatter events into partitions by ID
+// hash, and each partition folds its events into its own small table, so
+// tables stay cache-sized and tasks never share one. A partition sees its
+// IDs' events in file order, which keeps clock-ins paired with the right
+// clock-outs however the work is spread.
+class TimesheetAggregator {
+public:
+    struct Summary {
+        size_t bytes = 0;
+        size_t events = 0;
+        size_t malformed = 0;  // lines that are not ID,IN|OUT,seconds
+        size_t unmatched = 0;  // clock-outs without a clock-in, repeated or dangling clock-ins
+        size_t employees = 0;  // IDs with events
+        size_t openSessions = 0; // IDs still clocked in without a completed shift
+        size_t updated = 0;    // filled in by PayrollSystem::applyTimesheet
+        size_t notOnRoster = 0;
+        size_t notPartTime = 0;
+    };
+
+private:
+    static constexpr size_t partitionCount = 16;
+    static constexpr size_t segmentCount = 16;
+    static constexpr size_t chunkBytes = 8 << 20;
+    static constexpr int64_t maxTime = 1000000000000; // seconds; keeps sums far from overflow
+
+    struct Event {
+        EmployeeId id;
+        int64_t time;
+        bool clockIn;
+    };
+
+    struct Shift {
+        EmployeeId id;
+        int64_t openedAt; // -1 while clocked out
+        int64_t seconds;
+        bool worked;      // at least one shift was closed
+    };
+
+    struct Partition {
+        IdIndex index; // ID -> position in shifts
+        vector<Shift> shifts;
+        size_t unmatched = 0;
+    };
+
+    struct Segment {
+        vector<Event> events[partitionCount]; // kept between chunks for their capacity
+        size_t parsed = 0;
+        size_t malformed = 0;
+    };
+
+    TaskScheduler* tasks;
+    Partition partitions[partitionCount];
+    Segment segments[segmentCount];
+    Summary summary;
+
+    static size_t partitionOf(const EmployeeId& id) { return mixBits(id.raw()) >> 60; } // IdIndex uses the low bits
+
+    static bool parseLine(string_view line, Event& event) {
+        if(!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        size_t first = line.find(',');
+        size_t second = first == string_view::npos ? first : line.find(',', first + 1);
+        if(second == string_view::npos || second + 1 == line.size()) return false;
+        string_view kind = line.substr(first + 1, second - first - 1);
+        if(kind == "IN" || kind == "in") event.clockIn = true;
+        else if(kind == "OUT" || kind == "out") event.clockIn = false;
+        else return false;
+        int64_t time = 0;
+        for(char c : line.substr(second + 1)) {
+            if(c < '0' || c > '9') return false;
+            time = time * 10 + (c - '0');
+            if(time > maxTime) return false;
+        }
+        event.time = time;
+        return EmployeeId::lookup(line.substr(0, first), event.id);
+    }
+
+    void parseSegment(Segment& segment, const char* begin, const char* end) {
+        AllocScope scope(AllocCategory::Input);
+        Event event;
+        while(begin < end) {
+            const char* newline = static_cast<const char*>(memchr(begin, '\n', end - begin));
+            const char* lineEnd = newline ? newline : end;
+            if(lineEnd > begin) {
+                if(parseLine(string_view(begin, lineEnd - begin), event)) {
+                    segment.events[partitionOf(event.id)].push_back(event);
+                    segment.parsed++;
+                } else {
+                    segment.malformed++;
+                }
+            }
+            begin = lineEnd + 1;
+        }
+    }
+
+    void fold(Partition& partition, size_t p) {
+        AllocScope scope(AllocCategory::Index);
+        for(Segment& segment : segments) {
+            for(const Event& event : segment.events[p]) {
+                uint32_t position = partition.index.find(event.id);
+                if(position == IdIndex::npos) {
+                    position = static_cast<uint32_t>(partition.shifts.size());
+                    partition.index.insert(event.id, position);
+                    partition.shifts.push_back({ event.id, -1, 0, false });
+                }
+                Shift& shift = partition.shifts[position];
+                if(event.clockIn) {
+                    if(shift.openedAt >= 0) partition.unmatched++;
+                    shift.openedAt = event.time;
+                } else if(shift.openedAt < 0 || event.time < shift.openedAt) {
+                    partition.unmatched++;
+                    shift.openedAt = -1;
+                } else {
+                    shift.seconds += event.time - shift.openedAt;
+                    shift.openedAt = -1;
+                    shift.worked = true;
+                }
+            }
+            segment.events[p].clear();
+        }
+    }
+
+    // Complete lines only: [begin, end) ends just after a newline or at EOF.
+    void consume(const char* begin, const char* end) {
+        const char* cuts[segmentCount + 1];
+        cuts[0] = begin;
+        for(size_t s = 1; s < segmentCount; s++) {
+            const char* cut = max(cuts[s - 1], begin + (end - begin) * s / segmentCount);
+            const char* newline = cut < end ? static_cast<const char*>(memchr(cut, '\n', end - cut)) : nullptr;
+            cuts[s] = newline ? newline + 1 : end;
+        }
+        cuts[segmentCount] = end;
+        auto parse = [&](size_t first, size_t last) {
+            for(size_t s = first; s < last; s++) parseSegment(segments[s], cuts[s], cuts[s + 1]);
+        };
+        auto aggregate = [&](size_t first, size_t last) {
+            for(size_t p = first; p < last; p++) fold(partitions[p], p);
+        };
+        if(tasks) {
+            tasks->parallelFor(0, segmentCount, 1, parse);
+            tasks->parallelFor(0, partitionCount, 1, aggregate);
+        } else {
+            parse(0, segmentCount);
+            aggregate(0, partitionCount);
+        }
+    }
+
+public:
+    explicit TimesheetAggregator(TaskScheduler* tasks = nullptr) : tasks(tasks) {}
+
+    // Streams the file through a fixed buffer; false if it cannot be read.
+    bool consumeFile(const string& path) {
+        return forEachLineChunk(path, chunkBytes, summary.bytes,
+            [this](const char* begin, const char* end) { consume(begin, end); });
+    }
+
+    // Visits every employee seen with their matched seconds and whether any
+    // shift was completed, partition by partition in first-seen order.
+    template <typename F>
+    void forEachEmployee(F f) const {
+        for(const Partition& partition : partitions) {
+            for(const Shift& shift : partition.shifts) f(shift.id, shift.seconds, shift.worked);
+        }
+    }
+
+    Summary result() const {
+        Summary total = summary;
+        for(const Segment& segment : segments) {
+            total.events += segment.parsed;
+            total.malformed += segment.malformed;
+        }
+        for(const Partition& partition : partitions) {
+            total.unmatched += partition.unmatched;
+            total.employees += partition.shifts.size();
+            for(const Shift& shift : partition.shifts) {
+                total.unmatched += shift.openedAt >= 0; // never clocked out
+                total.openSessions += shift.openedAt >= 0 && !shift.worked;
+            }
+        }
+        return total;
+    }
+};
+
+// Contractor totals from a project-completion ledger, one
+// "employeeID,projectID,amount" line per completion. The same (employee,
+// project) pair may appear many times, e.g. from replayed exports; it
+// counts once, with the amount of its first appearance, so ingesting the
+// same records again changes nothing. Deduplication needs every distinct
+// pair, which can outgrow memory, so the ledger is streamed into
+// hash-partitioned spill files sized to the memory budget. Each partition
+// is then deduplicated on its own with a sort, and the partitions' per
+// contractor counts and amounts are merged.
+class ProjectLedger {
+public:
+    struct Summary {
+        size_t bytes = 0;
+        size_t lines = 0;
+        size_t malformed = 0;   // not ID,project,amount with at most two decimals
+        size_t duplicates = 0;  // repeats of a pair, same amount
+        size_t conflicts = 0;   // repeats of a pair with a different amount; the first is kept
+        size_t completions = 0; // distinct pairs
+        size_t contractors = 0;
+        size_t partitions = 0;
+        size_t largestPartition = 0; // bytes, the most held in memory at once
+        size_t updated = 0;          // filled in by PayrollSystem::applyLedger
+        size_t notOnRoster = 0;
+        size_t notContractual = 0;
+    };
+
+private:
+    static constexpr size_t chunkBytes = 8 << 20;
+    static constexpr size_t maxPartitions = 256; // each one holds a file open
+
+    struct Totals {
+        EmployeeId id;
+        int projects;
+        int64_t cents;
+    };
+
+    // A spilled record, pointing into its partition's buffer.
+    struct Completion {
+        EmployeeId employee;
+        size_t projectHash; // groups equal projects without comparing text first
+        string_view project;
+        int64_t cents;
+        uint32_t order; // position in the partition, to keep the first of a run
+    };
+
+    size_t memoryBudget;
+    vector<FILE*> spills;
+    bool spillFailed = false; // a short write; the partition cannot be trusted
+    IdIndex contractorIndex;
+    vector<Totals> totals;
+    Summary summary;
+
+    static bool parseCents(string_view text, int64_t& cents) {
+        if(!text.empty() && text.back() == '\r') text.remove_suffix(1);
+        size_t point = text.find('.');
+        string_view whole = text.substr(0, point);
+        string_view fraction = point == string_view::npos ? string_view() : text.substr(point + 1);
+        if(whole.empty() || whole.size() > 15 || fraction.size() > 2 || (point != string_view::npos && fraction.empty())) return false;
+        cents = 0;
+        for(char c : whole) {
+            if(c < '0' || c > '9') return false;
+            cents = cents * 10 + (c - '0');
+        }
+        for(size_t i = 0; i < 2; i++) {
+            char c = i < fraction.size() ? fraction[i] : '0';
+            if(c < '0' || c > '9') return false;
+            cents = cents * 10 + (c - '0');
+        }
+        return true;
+    }
+
+    // Spill record: employee, cents, project length, project bytes.
+    void spill(EmployeeId employee, string_view project, int64_t cents) {
+        uint64_t h = mixBits(employee.raw() ^ hash<string_view>()(project));
+        FILE* file = spills[h % spills.size()];
+        uint64_t raw = employee.raw();
+        uint16_t length = static_cast<uint16_t>(project.size());
+        if(fwrite(&raw, sizeof(raw), 1, file) != 1 || fwrite(&cents, sizeof(cents), 1, file) != 1
+           || fwrite(&length, sizeof(length), 1, file) != 1
+           || fwrite(project.data(), 1, project.size(), file) != project.size()) spillFailed = true;
+    }
+
+    void consume(const char* begin, const char* end) {
+        while(begin < end) {
+            const char* newline = static_cast<const char*>(memchr(begin, '\n', end - begin));
+            const char* lineEnd = newline ? newline : end;
+            string_view line(begin, lineEnd - begin);
+            begin = lineEnd + 1;
+            if(line.empty() || line == "\r") continue;
+            summary.lines++;
+            size_t first = line.find(',');
+            size_t second = first == string_view::npos ? first : line.find(',', first + 1);
+            EmployeeId id;
+            int64_t cents;
+            if(second == string_view::npos || second == first + 1 || second - first - 1 > 0xffff
+               || !EmployeeId::lookup(line.substr(0, first), id) || !parseCents(line.substr(second + 1), cents)) {
+                summary.malformed++;
+                continue;
+            }
+            spill(id, line.substr(first + 1, second - first - 1), cents);
+        }
+    }
+
+    bool mergePartition(FILE* file) {
+        AllocScope scope(AllocCategory::Input);
+        long size = ftell(file);
+        if(size < 0) return false;
+        summary.largestPartition = max(summary.largestPartition, size_t(size));
+        vector<char> data(size);
+        rewind(file);
+        if(fread(data.data(), 1, data.size(), file) != data.size()) return false;
+
+        vector<Completion> completions;
+        for(size_t at = 0; at < data.size();) {
+            Completion completion;
+            uint64_t employee;
+            uint16_t length;
+            memcpy(&employee, &data[at], sizeof(uint64_t));
+            completion.employee = EmployeeId::fromRaw(employee);
+            memcpy(&completion.cents, &data[at + 8], sizeof(int64_t));
+            memcpy(&length, &data[at + 16], sizeof(uint16_t));
+            completion.project = string_view(&data[at + 18], length);
+            completion.projectHash = hash<string_view>()(completion.project);
+            completion.order = static_cast<uint32_t>(completions.size());
+            completions.push_back(completion);
+            at += 18 + length;
+        }
+        sort(completions.begin(), completions.end(), [](const Completion& a, const Completion& b) {
+            if(a.employee != b.employee) return a.employee.raw() < b.employee.raw();
+            if(a.projectHash != b.projectHash) return a.projectHash < b.projectHash;
+            if(a.project != b.project) return a.project < b.project;
+            return a.order < b.order;
+        });
+
+        AllocScope indexScope(AllocCategory::Index);
+        size_t kept = 0; // first occurrence of the current pair
+        for(size_t i = 0; i < completions.size(); i++) {
+            const Completion& completion = completions[i];
+            if(i > 0 && completions[kept].employee == completion.employee && completions[kept].project == completion.project) {
+                if(completions[kept].cents == completion.cents) summary.duplicates++;
+                else summary.conflicts++;
+                continue;
+            }
+            kept = i;
+            summary.completions++;
+            const EmployeeId& id = completion.employee;
+            uint32_t position = contractorIndex.find(id);
+            if(position == IdIndex::npos) {
+                position = static_cast<uint32_t>(totals.size());
+                contractorIndex.insert(id, position);
+                totals.push_back({ id, 0, 0 });
+            }
+            totals[position].projects++;
+            totals[position].cents += completion.cents;
+        }
+        return true;
+    }
+
+public:
+    explicit ProjectLedger(size_t memoryBudget = size_t(256) << 20) : memoryBudget(memoryBudget) {}
+
+    ProjectLedger(const ProjectLedger&) = delete;
+    ProjectLedger& operator=(const ProjectLedger&) = delete;
+
+    ~ProjectLedger() {
+        for(FILE* file : spills) {
+            if(file) fclose(file);
+        }
+    }
+
+    // Reads the whole ledger; false if it or a spill file cannot be used.
+    // Spill files are anonymous temporaries, removed when closed.
+    bool ingestFile(const string& path) {
+        FILE* probe = fopen(path.c_str(), "rb");
+        if(!probe) return false;
+        fseek(probe, 0, SEEK_END);
+        long size = ftell(probe);
+        fclose(probe);
+        // Spilled records are about the size of their lines; aim for
+        // partitions of a quarter of the budget to leave room for sorting.
+        size_t partitions = 1;
+        while(partitions < maxPartitions && size_t(max(size, 0L)) / partitions > memoryBudget / 4) partitions *= 2;
+        for(size_t p = 0; p < partitions; p++) {
+            FILE* file = tmpfile();
+            if(!file) return false;
+            spills.push_back(file);
+        }
+        summary.partitions = partitions;
+        if(!forEachLineChunk(path, chunkBytes, summary.bytes,
+                [this](const char* begin, const char* end) { consume(begin, end); })) return false;
+        if(spillFailed) return false;
+        for(FILE*& file : spills) {
+            if(fflush(file) != 0 || ferror(file) || !mergePartition(file)) return false;
+            fclose(file); // frees the disk space as soon as the partition is done
+            file = nullptr;
+        }
+        spills.clear();
+        summary.contractors = totals.size();
+        return true;
+    }
+
+    // f(id, projects, cents) for every contractor with completions.
+    template <typename F>
+    void forEachContractor(F f) const {
+        for(const Totals& contractor : totals) f(contractor.id, contractor.projects, contractor.cents);
+    }
+
+    Summary result() const { return summary; }
+};
+
+// Joins a delimited feed (bank accounts, tax codes, departments, ...) to a
+// roster snapshot by the employee ID in one of its columns. Both sides are
+// radix-partitioned on the ID hash so that each partition's hash table is
+// small enough to stay in cache while it is probed. The feed is streamed in
+// chunks: segments of a chunk are parsed and scattered in parallel, the
+// partitions are probed in parallel, and the rows are written back out in
+// input order. Matched rows get the employee's name, type and salary
+// appended; unmatched rows are written unchanged.
+class RosterJoin {
+public:
+    struct Summary {
+        size_t bytes = 0;
+        size_t rows = 0;
+        size_t matched = 0;
+        size_t unmatched = 0;
+        size_t unkeyed = 0; // unmatched rows without a usable ID in the key column
+    };
+
+private:
+    static constexpr int partitionBits = 8;
+    static constexpr size_t partitionCount = size_t(1) << partitionBits;
+    static constexpr size_t segmentCount = 16;
+    static constexpr size_t chunkBytes = 8 << 20;
+
+    struct Probe {
+        EmployeeId id;
+        uint32_t line; // within the segment
+    };
+
+    struct Partition {
+        IdIndex index; // ID -> position in built
+    };
+
+    struct Segment {
+        vector<string_view> lines;
+        vector<const Employee*> matches; // per line, nullptr if unmatched
+        vector<Probe> probes[partitionCount]; // kept between chunks for their capacity
+        string matchedOut;
+        string unmatchedOut;
+        size_t unkeyed = 0;
+    };
+
+    shared_ptr<const RosterSnapshot> roster;
+    TaskScheduler* tasks;
+    char delimiter;
+    size_t keyColumn;
+    vector<const Employee*> built; // roster employees grouped by partition
+    Partition partitions[partitionCount];
+    Segment segments[segmentCount];
+    Summary summary;
+
+    static size_t partitionOf(const EmployeeId& id) { return mixBits(id.raw()) >> (64 - partitionBits); } // IdIndex uses the low bits
+
+    void run(size_t count, size_t grain, const function<void(size_t, size_t)>& f) {
+        if(tasks) tasks->parallelFor(size_t(0), count, grain, f);
+        else f(0, count);
+    }
+
+    // Two-pass radix scatter of the roster: count per block and partition,
+    // then place every employee at its partition's running offset.
+    void build() {
+        AllocScope scope(AllocCategory::Index);
+        const size_t grain = RosterSnapshot::parallelGrain;
+        size_t blocks = (roster->rows.size() + grain - 1) / grain;
+        vector<uint32_t> offsets(blocks * partitionCount);
+        run(blocks, 1, [&](size_t first, size_t last) {
+            for(size_t b = first; b < last; b++) {
+                uint32_t* counts = &offsets[b * partitionCount];
+                roster->rows.forEachInRange(b * grain, min(roster->rows.size(), (b + 1) * grain), [&](const Employee* emp) {
+                    if(emp) counts[partitionOf(emp->getId())]++;
+                });
+            }
+        });
+        vector<uint32_t> starts(partitionCount + 1);
+        uint32_t at = 0;
+        for(size_t p = 0; p < partitionCount; p++) {
+            starts[p] = at;
+            for(size_t b = 0; b < blocks; b++) {
+                uint32_t count = offsets[b * partitionCount + p];
+                offsets[b * partitionCount + p] = at;
+                at += count;
+            }
+        }
+        starts[partitionCount] = at;
+        built.assign(at, nullptr);
+        run(blocks, 1, [&](size_t first, size_t last) {
+            for(size_t b = first; b < last; b++) {
+                uint32_t* next = &offsets[b * partitionCount];
+                roster->rows.forEachInRange(b * grain, min(roster->rows.size(), (b + 1) * grain), [&](const Employee* emp) {
+                    if(emp) built[next[partitionOf(emp->getId())]++] = emp;
+                });
+            }
+        });
+        run(partitionCount, 1, [&](size_t first, size_t last) {
+            AllocScope taskScope(AllocCategory::Index);
+            for(size_t p = first; p < last; p++) {
+                partitions[p].index.reserve(starts[p + 1] - starts[p]);
+                for(uint32_t i = starts[p]; i < starts[p + 1]; i++) partitions[p].index.insert(built[i]->getId(), i);
+            }
+        });
+    }
+
+    bool keyOf(string_view line, EmployeeId& id) const {
+        for(size_t column = 0; column < keyColumn; column++) {
+            size_t next = line.find(delimiter);
+            if(next == string_view::npos) return false;
+            line.remove_prefix(next + 1);
+        }
+        return EmployeeId::lookup(line.substr(0, line.find(delimiter)), id);
+    }
+
+    void parseSegment(Segment& segment, const char* begin, const char* end) {
+        AllocScope scope(AllocCategory::Input);
+        segment.lines.clear();
+        EmployeeId id;
+        while(begin < end) {
+            const char* newline = static_cast<const char*>(memchr(begin, '\n', end - begin));
+            const char* lineEnd = newline ? newline : end;
+            string_view line(begin, lineEnd - begin);
+            begin = lineEnd + 1;
+            if(!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            if(line.empty()) continue;
+            uint32_t number = static_cast<uint32_t>(segment.lines.size());
+            segment.lines.push_back(line);
+            if(keyOf(line, id)) segment.probes[partitionOf(id)].push_back({ id, number });
+            else segment.unkeyed++;
+        }
+        segment.matches.assign(segment.lines.size(), nullptr);
+    }
+
+    void probe(size_t p) {
+        const IdIndex& index = partitions[p].index;
+        for(Segment& segment : segments) {
+            for(const Probe& probe : segment.probes[p]) {
+                uint32_t position = index.find(probe.id);
+                if(position != IdIndex::npos) segment.matches[probe.line] = built[position];
+            }
+            segment.probes[p].clear();
+        }
+    }
+
+    void render(Segment& segment, bool keepMatched, bool keepUnmatched) {
+        AllocScope scope(AllocCategory::Report);
+        segment.matchedOut.clear();
+        segment.unmatchedOut.clear();
+        for(size_t i = 0; i < segment.lines.size(); i++) {
+            const Employee* emp = segment.matches[i];
+            if(!(emp ? keepMatched : keepUnmatched)) continue;
+            string& out = emp ? segment.matchedOut : segment.unmatchedOut;
+            out += segment.lines[i];
+            if(emp) {
+                out += delimiter; out += emp->getName();
+                out += delimiter; out += employeeTypeName(emp->getType());
+                out += delimiter; appendNumber(out, emp->getSalary());
+            }
+            out += '\n';
+        }
+    }
+
+public:
+    RosterJoin(shared_ptr<const RosterSnapshot> roster, TaskScheduler* tasks = nullptr, char delimiter = ',', size_t keyColumn = 0)
+        : roster(move(roster)), tasks(tasks), delimiter(delimiter), keyColumn(keyColumn) {
+        build();
+    }
+
+    // Streams the feed, writing each row to matched or unmatched (either may
+    // be null to discard them); false if the feed cannot be read or an
+    // output cannot be written.
+    bool joinFile(const string& path, FILE* matched, FILE* unmatched) {
+        bool written = true;
+        bool read = forEachLineChunk(path, chunkBytes, summary.bytes, [&](const char* begin, const char* end) {
+            const char* cuts[segmentCount + 1];
+            cuts[0] = begin;
+            for(size_t s = 1; s < segmentCount; s++) {
+                const char* cut = max(cuts[s - 1], begin + (end - begin) * s / segmentCount);
+                const char* newline = cut < end ? static_cast<const char*>(memchr(cut, '\n', end - cut)) : nullptr;
+                cuts[s] = newline ? newline + 1 : end;
+            }
+            cuts[segmentCount] = end;
+            run(segmentCount, 1, [&](size_t first, size_t last) {
+                for(size_t s = first; s < last; s++) parseSegment(segments[s], cuts[s], cuts[s + 1]);
+            });
+            run(partitionCount, 8, [&](size_t first, size_t last) {
+                for(size_t p = first; p < last; p++) probe(p);
+            });
+            if(matched || unmatched) {
+                run(segmentCount, 1, [&](size_t first, size_t last) {
+                    for(size_t s = first; s < last; s++) render(segments[s], matched, unmatched);
+                });
+            }
+            for(const Segment& segment : segments) {
+                summary.rows += segment.lines.size();
+                for(const Employee* emp : segment.matches) summary.matched += emp != nullptr;
+                if(matched) written = fwrite(segment.matchedOut.data(), 1, segment.matchedOut.size(), matched) == segment.matchedOut.size() && written;
+                if(unmatched) written = fwrite(segment.unmatchedOut.data(), 1, segment.unmatchedOut.size(), unmatched) == segment.unmatchedOut.size() && written;
+            }
+        });
+        return read && written;
+    }
+
+    Summary result() const {
+        Summary total = summary;
+        for(const Segment& segment : segments) total.unkeyed += segment.unkeyed;
+        total.unmatched = total.rows - total.matched;
+        return total;
+    }
+};
+
+// Roster files hold one employee per line, "ID,type,pay,quantity,name",
+// sorted by ID. type is F (pay is the monthly salary, quantity 0), P (hourly
+// rate, hours worked) or C (payment per project, projects completed). Pay is
+// written in its shortest exact form, so saving and loading round-trips.
+// A change set turns one roster file into another, one line per employee:
+// "+record" added, "-ID" removed, "~record" the new version of a changed one.
+// A plain record applies as an add, so a roster file is a change set too.
+void appendShortest(string& out, double value) {
+    char buffer[32];
+    to_chars_result written = to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, written.ptr - buffer);
+}
+
+void appendRosterLine(string& out, const Employee* emp) {
+    emp->getId().appendTo(out);
+    switch(emp->getType()) {
+        case EmployeeType::FullTime:
+            out += ",F,"; appendShortest(out, emp->getSalary()); out += ",0,";
+            break;
+        case EmployeeType::PartTime: {
+            auto* partTime = static_cast<const PartTimeEmployee*>(emp);
+            out += ",P,"; appendShortest(out, partTime->getHourlyRate());
+            out += ','; appendNumber(out, partTime->getHoursWorked()); out += ',';
+            break;
+        }
+        default: {
+            auto* contractual = static_cast<const ContractualEmployee*>(emp);
+            out += ",C,"; appendShortest(out, contractual->getPaymentPerProject());
+            out += ','; appendNumber(out, contractual->getProjectsCompleted()); out += ',';
+            break;
+        }
+    }
+    out += emp->getName();
+    out += '\n';
+}
+
+// The ID field of a roster line; false if the line has nothing after it.
+bool rosterLineId(string_view line, string_view& id) {
+    size_t comma = line.find(',');
+    if(comma == 0 || comma == string_view::npos) return false;
+    id = line.substr(0, comma);
+    return true;
+}
+
+// The type, pay and quantity fields together: what a pay change changes.
+string_view rosterPayFields(string_view line) {
+    size_t end = 0;
+    for(int field = 0; field < 4 && end != string_view::npos; field++) end = line.find(',', end + (field > 0));
+    return line.substr(0, end);
+}
+
+// The rules the interactive prompts enforce on trimmed input: IDs are letters
+// and digits, names are letters with single spaces between words.
+bool isValidIdText(string_view text) {
+    if(text.empty()) return false;
+    for(char c : text) {
+        if(!isalnum(static_cast<unsigned char>(c))) return false;
+    }
+    return true;
+}
+
+bool isValidNameText(string_view text) {
+    if(text.empty() || isspace(static_cast<unsigned char>(text.front()))
+       || isspace(static_cast<unsigned char>(text.back()))) return false;
+    bool prevSpace = false;
+    for(char c : text) {
+        if(isspace(static_cast<unsigned char>(c))) {
+            if(prevSpace) return false;
+            prevSpace = true;
+        } else {
+            if(!isalpha(static_cast<unsigned char>(c))) return false;
+            prevSpace = false;
+        }
+    }
+    return true;
+}
+
+// The employee a roster line describes, or nullptr if it is malformed.
+Employee* parseRosterLine(string_view line) {
+    string_view fields[5];
+    for(int i = 0; i < 4; i++) {
+        size_t comma = line.find(',');
+        if(comma == string_view::npos) return nullptr;
+        fields[i] = line.substr(0, comma);
+        line.remove_prefix(comma + 1);
+    }
+    fields[4] = line;
+    double pay = 0;
+    int quantity = 0;
+    const char* payEnd = fields[2].data() + fields[2].size();
+    const char* quantityEnd = fields[3].data() + fields[3].size();
+    if(!isValidIdText(fields[0]) || fields[1].size() != 1 || fields[2].empty() || fields[3].empty()
+       || !isValidNameText(fields[4])
+       || from_chars(fields[2].data(), payEnd, pay).ptr != payEnd || pay < 0
+       || from_chars(fields[3].data(), quantityEnd, quantity).ptr != quantityEnd || quantity < 0) return nullptr;
+    EmployeeId id = EmployeeId::fromString(string(fields[0]));
+    AllocScope scope(AllocCategory::Employee);
+    switch(fields[1][0]) {
+        case 'F': return new FullTimeEmployee(id, fields[4], pay);
+        case 'P': return new PartTimeEmployee(id, fields[4], pay, quantity);
+        case 'C': return new ContractualEmployee(id, fields[4], pay, quantity);
+        default: return nullptr;
+    }
+}
+
+// Reads lines from an open file through a buffer that grows only for lines
+// longer than it. A line stays valid until the next call.
+class LineReader {
+    FILE* file;
+    vector<char> buffer;
+    size_t begin = 0;
+    size_t end = 0;
+    bool atEnd = false;
+
+public:
+    explicit LineReader(FILE* file, size_t bufferBytes = 1 << 20) : file(file) {
+        AllocScope scope(AllocCategory::Input);
+        buffer.resize(max(bufferBytes, size_t(4096)));
+    }
+
+    bool next(string_view& line) {
+        for(;;) {
+            const char* first = buffer.data() + begin;
+            const char* newline = static_cast<const char*>(memchr(first, '\n', end - begin));
+            if(newline || (atEnd && begin < end)) {
+                const char* last = newline ? newline : buffer.data() + end;
+                line = string_view(first, last - first);
+                begin = newline ? newline - buffer.data() + 1 : end;
+                if(!line.empty() && line.back() == '\r') line.remove_suffix(1);
+                return true;
+            }
+            if(atEnd) return false;
+            memmove(buffer.data(), first, end - begin);
+            end -= begin;
+            begin = 0;
+            if(end == buffer.size()) {
+                AllocScope scope(AllocCategory::Input);
+                buffer.resize(buffer.size() * 2);
+            }
+            size_t read = fread(buffer.data() + end, 1, buffer.size() - end, file);
+            end += read;
+            atEnd = read == 0;
+        }
+    }
+
+    bool failed() const { return ferror(file) != 0; }
+};
+
+// Merges sorted roster streams by ID; equal IDs come out in stream order.
+// The returned line stays valid until the next call.
+class RosterStreamMerge {
+    vector<LineReader> readers;
+    vector<string_view> lines;
+    vector<string_view> ids;
+    vector<size_t> heap; // stream indexes, smallest (ID, stream) on top
+    size_t advance = SIZE_MAX; // stream to read from before the next pop
+
+    bool later(size_t a, size_t b) const { return ids[a] != ids[b] ? ids[a] > ids[b] : a > b; }
+
+    void push(size_t stream) {
+        string_view line;
+        while(readers[stream].next(line)) {
+            if(!rosterLineId(line, ids[stream])) continue;
+            lines[stream] = line;
+            heap.push_back(stream);
+            push_heap(heap.begin(), heap.end(), [this](size_t a, size_t b) { return later(a, b); });
+            return;
+        }
+    }
+
+public:
+    RosterStreamMerge(const vector<FILE*>& files, size_t bufferBytes) : lines(files.size()), ids(files.size()) {
+        AllocScope scope(AllocCategory::Input);
+        readers.reserve(files.size());
+        for(FILE* file : files) readers.emplace_back(file, bufferBytes);
+        for(size_t stream = 0; stream < files.size(); stream++) push(stream);
+    }
+
+    bool next(string_view& line, string_view& id, size_t& stream) {
+        if(advance != SIZE_MAX) push(advance);
+        if(heap.empty()) {
+            advance = SIZE_MAX;
+            return false;
+        }
+        pop_heap(heap.begin(), heap.end(), [this](size_t a, size_t b) { return later(a, b); });
+        stream = advance = heap.back();
+        heap.pop_back();
+        line = lines[stream];
+        id = ids[stream];
+        return true;
+    }
+
+    bool failed() const {
+        for(const LineReader& reader : readers) if(reader.failed()) return true;
+        return false;
+    }
+};
+
+struct RosterSortStats {
+    size_t lines = 0;
+    size_t malformed = 0; // blank or without an ID; dropped
+    size_t runs = 0;      // 0 if the file was already sorted
+};
+
+struct RosterRunLine {
+    size_t offset;
+    uint32_t length;
+    uint32_t idLength;
+};
+
+// Stable sort by ID: slices sorted in parallel, then merged pairwise.
+void sortRosterRun(const string& text, vector<RosterRunLine>& lines, TaskScheduler* tasks) {
+    auto byId = [&text](const RosterRunLine& a, const RosterRunLine& b) {
+        return string_view(&text[a.offset], a.idLength) < string_view(&text[b.offset], b.idLength);
+    };
+    size_t slices = tasks && lines.size() > 65536 ? 16 : 1;
+    vector<size_t> cuts(slices + 1);
+    for(size_t s = 0; s <= slices; s++) cuts[s] = lines.size() * s / slices;
+    auto sortSlices = [&](size_t first, size_t last) {
+        for(size_t s = first; s < last; s++) stable_sort(lines.begin() + cuts[s], lines.begin() + cuts[s + 1], byId);
+    };
+    if(slices == 1) {
+        sortSlices(0, 1);
+        return;
+    }
+    tasks->parallelFor(size_t(0), slices, 1, sortSlices);
+    for(size_t width = 1; width < slices; width *= 2) {
+        tasks->parallelFor(size_t(0), slices / (2 * width), 1, [&](size_t first, size_t last) {
+            for(size_t pair = first; pair < last; pair++) {
+                size_t left = pair * 2 * width;
+                inplace_merge(lines.begin() + cuts[left], lines.begin() + cuts[left + width],
+                              lines.begin() + cuts[left + 2 * width], byId);
+            }
+        });
+    }
+}
+
+bool writeRosterRun(const string& text, const vector<RosterRunLine>& lines, FILE* out) {
+    AllocScope scope(AllocCategory::Report);
+    string block;
+    bool written = true;
+    for(const RosterRunLine& line : lines) {
+        block.append(&text[line.offset], line.length);
+        block += '\n';
+        if(block.size() > (1 << 20)) {
+            written = fwrite(block.data(), 1, block.size(), out) == block.size() && written;
+            block.clear();
+        }
+    }
+    return fwrite(block.data(), 1, block.size(), out) == block.size() && written;
+}
+
+// External merge sort of a roster file by ID into out. Runs of up to half
+// the memory budget are sorted in parallel and spilled to temporary files,
+// then merged in one pass; a file that fits is sorted in memory. Lines with
+// equal IDs keep their input order. False if a file cannot be read or written.
+bool sortRosterFile(const string& path, FILE* out, size_t memoryBudget, TaskScheduler* tasks, RosterSortStats& stats) {
+    FILE* in = fopen(path.c_str(), "rb");
+    if(!in) return false;
+    vector<FILE*> runs;
+    string text;
+    vector<RosterRunLine> lines;
+    bool ok = true;
+    auto closeAll = [&]() {
+        fclose(in);
+        for(FILE* run : runs) fclose(run);
+        return ok;
+    };
+    auto spill = [&]() {
+        sortRosterRun(text, lines, tasks);
+        FILE* run = tmpfile();
+        ok = run && writeRosterRun(text, lines, run) && fflush(run) == 0;
+        if(run) {
+            rewind(run);
+            runs.push_back(run);
+        }
+        text.clear();
+        lines.clear();
+    };
+
+    {
+        AllocScope scope(AllocCategory::Input);
+        LineReader reader(in, min(memoryBudget / 8, size_t(8) << 20));
+        string_view line, id;
+        while(ok && reader.next(line)) {
+            if(!rosterLineId(line, id)) {
+                stats.malformed++;
+                continue;
+            }
+            if(text.size() + line.size() > memoryBudget / 2 && !lines.empty()) spill();
+            lines.push_back({ text.size(), static_cast<uint32_t>(line.size()), static_cast<uint32_t>(id.size()) });
+            text += line;
+            stats.lines++;
+        }
+        ok = ok && !reader.failed();
+    }
+    if(!ok) return closeAll();
+    if(runs.empty()) {
+        sortRosterRun(text, lines, tasks);
+        ok = writeRosterRun(text, lines, out);
+        return closeAll();
+    }
+    if(!lines.empty()) spill();
+    if(!ok) return closeAll();
+    stats.runs = runs.size();
+    text = string();
+    lines = vector<RosterRunLine>();
+
+    AllocScope scope(AllocCategory::Report);
+    RosterStreamMerge merge(runs, max(memoryBudget / 2 / runs.size(), size_t(64) << 10));
+    string block;
+    string_view line, id;
+    size_t stream;
+    while(merge.next(line, id, stream)) {
+        block += line;
+        block += '\n';
+        if(block.size() > (1 << 20)) {
+            ok = fwrite(block.data(), 1, block.size(), out) == block.size() && ok;
+            block.clear();
+        }
+    }
+    ok = fwrite(block.data(), 1, block.size(), out) == block.size() && ok && !merge.failed();
+    return closeAll();
+}
+
+// The roster file opened for reading if it is already sorted by ID and has
+// no malformed lines, otherwise a sorted temporary copy; nullptr on failure.
+FILE* openSortedRoster(const string& path, size_t memoryBudget, TaskScheduler* tasks, RosterSortStats& stats) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if(!file) return nullptr;
+    bool sorted = true;
+    {
+        AllocScope scope(AllocCategory::Input);
+        LineReader reader(file);
+        string previous;
+        string_view line, id;
+        size_t lines = 0;
+        while(sorted && reader.next(line)) {
+            sorted = rosterLineId(line, id) && (lines == 0 || string_view(previous) <= id);
+            previous.assign(id.data(), id.size());
+            lines++;
+        }
+        if(sorted && !reader.failed()) {
+            stats.lines = lines;
+            rewind(file);
+            return file;
+        }
+    }
+    fclose(file);
+    FILE* copy = tmpfile();
+    if(!copy) return nullptr;
+    if(!sortRosterFile(path, copy, memoryBudget, tasks, stats) || fflush(copy) != 0) {
+        fclose(copy);
+        return nullptr;
+    }
+    rewind(copy);
+    return copy;
+}
+
+struct RosterDiff {
+    size_t unchanged = 0;
+    size_t added = 0;
+    size_t removed = 0;
+    size_t payChanges = 0; // type, pay or quantity changed
+    size_t renamed = 0;    // only the name changed
+    size_t duplicates = 0; // later lines for an ID already seen in the same file; ignored
+    RosterSortStats before;
+    RosterSortStats after;
+};
+
+// Writes the change set that turns the before roster into the after one.
+// Unsorted inputs are sorted externally first; the diff itself is one
+// linear pass over both. False if a file cannot be read or written.
+bool diffRosterFiles(const string& beforePath, const string& afterPath, FILE* changes, RosterDiff& diff,
+                     size_t memoryBudget = size_t(256) << 20, TaskScheduler* tasks = nullptr) {
+    FILE* files[2] = { openSortedRoster(beforePath, memoryBudget, tasks, diff.before), nullptr };
+    if(files[0]) files[1] = openSortedRoster(afterPath, memoryBudget, tasks, diff.after);
+    if(!files[1]) {
+        if(files[0]) fclose(files[0]);
+        return false;
+    }
+
+    AllocScope scope(AllocCategory::Report);
+    bool ok = true;
+    {
+        LineReader readers[2] = { LineReader(files[0]), LineReader(files[1]) };
+        string_view lines[2], ids[2];
+        string lastIds[2];
+        bool has[2];
+        auto advance = [&](int side) {
+            while((has[side] = readers[side].next(lines[side]))) {
+                if(!rosterLineId(lines[side], ids[side])) continue;
+                if(!lastIds[side].empty() && ids[side] == lastIds[side]) {
+                    diff.duplicates++;
+                    continue;
+                }
+                lastIds[side].assign(ids[side].data(), ids[side].size());
+                return;
+            }
+        };
+        advance(0);
+        advance(1);
+        string block;
+        while(has[0] || has[1]) {
+            if(has[0] && (!has[1] || ids[0] < ids[1])) {
+                block += '-'; block += ids[0]; block += '\n';
+                diff.removed++;
+                advance(0);
+            } else if(has[1] && (!has[0] || ids[1] < ids[0])) {
+                block += '+'; block += lines[1]; block += '\n';
+                diff.added++;
+                advance(1);
+            } else {
+                if(lines[0] == lines[1]) {
+                    diff.unchanged++;
+                } else {
+                    block += '~'; block += lines[1]; block += '\n';
+                    if(rosterPayFields(lines[0]) == rosterPayFields(lines[1])) diff.renamed++;
+                    else diff.payChanges++;
+                }
+                advance(0);
+                advance(1);
+            }
+            if(block.size() > (1 << 20)) {
+                ok = fwrite(block.data(), 1, block.size(), changes) == block.size() && ok;
+                block.clear();
+            }
+        }
+        ok = fwrite(block.data(), 1, block.size(), changes) == block.size() && ok
+          && !readers[0].failed() && !readers[1].failed();
+    }
+    fclose(files[0]);
+    fclose(files[1]);
+    return ok;
+}
+
+struct RosterMerge {
+    size_t employees = 0;
+    size_t duplicates = 0; // repeated records, identical to the one kept
+    size_t conflicts = 0;  // different records for a kept ID; the earliest input wins
+    vector<RosterSortStats> inputs;
+};
+
+// Merges rosters (e.g. regional ones) into one sorted roster file. An ID in
+// several inputs keeps its record from the first input listing it. Each
+// input is sorted externally if needed, then all are merged in one pass.
+bool mergeRosterFiles(const vector<string>& paths, FILE* out, RosterMerge& merge,
+                      size_t memoryBudget = size_t(256) << 20, TaskScheduler* tasks = nullptr) {
+    vector<FILE*> files;
+    merge.inputs.assign(paths.size(), RosterSortStats());
+    for(size_t i = 0; i < paths.size(); i++) {
+        FILE* file = openSortedRoster(paths[i], memoryBudget, tasks, merge.inputs[i]);
+        if(!file) {
+            for(FILE* opened : files) fclose(opened);
+            return false;
+        }
+        files.push_back(file);
+    }
+
+    AllocScope scope(AllocCategory::Report);
+    bool ok = true;
+    {
+        RosterStreamMerge streams(files, max(memoryBudget / 2 / max(files.size(), size_t(1)), size_t(64) << 10));
+        string block, keptId, keptLine;
+        string_view line, id;
+        size_t stream;
+        while(streams.next(line, id, stream)) {
+            if(merge.employees > 0 && id == keptId) {
+                if(line == keptLine) merge.duplicates++;
+                else merge.conflicts++;
+                continue;
+            }
+            keptId.assign(id.data(), id.size());
+            keptLine.assign(line.data(), line.size());
+            merge.employees++;
+            block += line;
+            block += '\n';
+            if(block.size() > (1 << 20)) {
+                ok = fwrite(block.data(), 1, block.size(), out) == block.size() && ok;
+                block.clear();
+            }
+        }
+        ok = fwrite(block.data(), 1, block.size(), out) == block.size() && ok && !streams.failed();
+    }
+    for(FILE* file : files) fclose(file);
+    return ok;
+}
+
+// Adds staged for an all-or-nothing commit. The batch owns its employees
+// until PayrollSystem::commitBatch takes them.
+class PayrollBatch {
+    vector<Employee*> staged;
+    friend class PayrollSystem;
+    friend class ShardedPayrollSystem;
+
+public:
+    PayrollBatch() = default;
+    PayrollBatch(const PayrollBatch&) = delete;
+    PayrollBatch& operator=(const PayrollBatch&) = delete;
+
+    ~PayrollBatch() { clear(); }
+
+    template <typename T, typename... Args>
+    T* stage(EmployeeId id, string_view name, Args&&... args) {
+        AllocScope scope(AllocCategory::Employee);
+        T* emp = new T(id, name, std::forward<Args>(args)...);
+        staged.push_back(emp);
+        return emp;
+    }
+
+    // Takes ownership of emp.
+    void stage(Employee* emp) {
+        AllocScope scope(AllocCategory::Employee);
+        staged.push_back(emp);
+    }
+
+    size_t size() const { return staged.size(); }
+    const Employee* at(size_t index) const { return staged[index]; }
+
+    void clear() {
+        for(Employee* emp : staged) delete emp;
+        staged.clear();
+    }
+};
+
+struct BatchIssue {
+    size_t index; // position in the batch
+    EmployeeId id;
+    const char* reason;
+};
+
+// What to put back for one ID when a step is undone or redone.
+struct HistoryChange {
+    EmployeeId id;
+    const Employee* restore; // nullptr if the ID was absent
+    uint32_t row;            // row the ID held, so it returns to its place
+};
+
+// One undoable operation. The snapshot published just before it keeps the
+// employees to restore (and the trie nodes only that version reaches) alive,
+// so history grows with what changed rather than with the roster.
+struct HistoryStep {
+    shared_ptr<const RosterSnapshot> before;
+    vector<HistoryChange> changes;
+    size_t rowEpoch; // recorded rows are stale once compaction has moved rows since
+};
+
+class PayrollSystem {
+    friend class ShardedPayrollSystem; // holds shard locks across a batch
+
+    Roster roster;
+    mutable string reportBuffer;
+
+    // Writers serialize on rosterLock and publish a new snapshot after every
+    // change. Snapshot readers (lookups, totals, the full report) never take
+    // it; queries over the live indexes do.
+    mutable recursive_mutex rosterLock;
+    RosterSnapshot working; // the next version, edited in place by writers
+    shared_ptr<const RosterSnapshot> published;
+    deque<unique_ptr<RetireList>> retiring; // oldest first; back() takes new garbage
+
+    // Set for concurrent ingest: IDs are claimed lock-free before the roster
+    // lock is taken, so duplicate records are turned away without waiting.
+    unique_ptr<ConcurrentIdSet> claimedIds;
+
+    // Application-owned pool for bulk operations; nullptr runs them serially.
+    TaskScheduler* scheduler = nullptr;
+
+    PayHistory payHistory;
+
+    // Pay columns of the latest version scenarios were asked for; forks are
+    // copies of it.
+    mutable mutex scenarioLock;
+    mutable unique_ptr<const PayrollScenario> scenarioRoot;
+
+    // Undo/redo, off until keepHistory. Changes made since the last publish
+    // become one step when it runs.
+    size_t historyLimit = 0;
+    deque<HistoryStep> undoSteps;
+    deque<HistoryStep> redoSteps;
+    vector<HistoryChange> pendingChanges;
+    size_t pendingRowEpoch = 0;
+
+    // Compaction starts once this share of rows (and at least compactionMinDead)
+    // are tombstones. Handles keep indexes valid, so it is a linear pass, run
+    // compactionStepRows rows per publish to keep every writer's hold on the
+    // lock short.
+    static constexpr double compactionRatio = 0.25;
+    static constexpr size_t compactionMinDead = 64;
+    static constexpr size_t compactionStepRows = 1024;
+
+    size_t compactions = 0; // finished
+    size_t rowEpoch = 0;    // bumped whenever compaction moves rows
+
+    bool isIdUnique(const EmployeeId& id) const {
+        return !roster.idIndex.contains(id);
+    }
+
+    bool isIdUnique(const string& id) const {
+        EmployeeId key;
+        return !EmployeeId::lookup(id, key) || isIdUnique(key);
+    }
+
+    const Employee* liveEmployee(const EmployeeId& id) const {
+        uint32_t slot = roster.idIndex.find(id);
+        return slot == IdIndex::npos ? nullptr : roster.bySlot(slot);
+    }
+
+    uint32_t rowOf(const EmployeeId& id) const {
+        uint32_t slot = roster.idIndex.find(id);
+        return slot == IdIndex::npos ? HandleTable::npos : roster.handles.rowOf(slot);
+    }
+
+    VersionEdit edit() const { return { working.version, retiring.back().get() }; }
+
+    void storeEmployee(Employee* emp, uint32_t row = HandleTable::npos) {
+        row = roster.handles.rowOf(roster.insert(emp, row));
+        if(row < working.rows.size()) working.rows.set(row, emp, edit());
+        else working.rows.push_back(emp, edit());
+        working.byId.assign(emp->getId().raw(), emp, edit());
+        working.typeCounts[static_cast<size_t>(emp->getType())]++;
+    }
+
+    Employee* dropEmployee(const EmployeeId& id, uint32_t row) {
+        Employee* removed = roster.remove(id);
+        working.rows.set(row, nullptr, edit());
+        working.byId.erase(id.raw(), edit());
+        working.typeCounts[static_cast<size_t>(removed->getType())]--;
+        retire(removed);
+        return removed;
+    }
+
+    // previous is what undo restores for id: nullptr for an add.
+    void recordChange(const EmployeeId& id, const Employee* previous, uint32_t row) {
+        if(!historyLimit) return;
+        AllocScope scope(AllocCategory::Index);
+        if(pendingChanges.empty()) pendingRowEpoch = rowEpoch;
+        pendingChanges.push_back({ id, previous, row });
+    }
+
+    // Snapshots may still point at emp; it is freed with the last of them.
+    void retire(const Employee* emp) {
+        retiring.back()->add(emp);
+    }
+
+    // Freezes working as the current version, starts the next one and frees
+    // whatever no remaining snapshot can reach.
+    void publish() {
+        AllocScope scope(AllocCategory::Index);
+        if(roster.compacting) advanceCompaction();
+        if(!pendingChanges.empty()) {
+            undoSteps.push_back({ atomic_load(&published), std::move(pendingChanges), pendingRowEpoch });
+            pendingChanges.clear();
+            redoSteps.clear();
+            if(undoSteps.size() > historyLimit) undoSteps.pop_front();
+        }
+        retiring.push_back(make_unique<RetireList>());
+        RetireList* garbage = retiring.back().get();
+        shared_ptr<const RosterSnapshot> next(new RosterSnapshot(working), [garbage](const RosterSnapshot* snap) {
+            garbage->released.store(true, memory_order_release);
+            delete snap;
+        });
+        working.version++;
+        atomic_store(&published, next);
+        while(retiring.size() > 1 && retiring.front()->released.load(memory_order_acquire)) {
+            retiring.pop_front();
+        }
+    }
+
+    // Starts compaction; publish() moves it along.
+    void compactIfNeeded() {
+        if(roster.compacting || roster.deadCount < compactionMinDead ||
+           roster.deadCount < roster.employees.size() * compactionRatio) return;
+        roster.startCompaction();
+    }
+
+    void advanceCompaction() {
+        bool moved = false;
+        bool finished = roster.compactStep(compactionStepRows, [&](size_t from, size_t to) {
+            working.rows.set(to, roster.employees[to], edit());
+            working.rows.set(from, nullptr, edit());
+            moved = true;
+        });
+        if(finished) {
+            working.rows.truncate(roster.employees.size());
+            compactions++;
+        }
+        if(moved || finished) rowEpoch++;
+    }
+
+    // Swaps in an edited clone; the caller holds the lock and publishes.
+    template <typename T, typename Change>
+    bool changeEmployee(const EmployeeId& id, EmployeeType type, Change change) {
+        const Employee* current = liveEmployee(id);
+        if(!current || current->getType() != type) return false;
+        T* updated;
+        {
+            AllocScope scope(AllocCategory::Employee);
+            updated = static_cast<T*>(current->clone());
+        }
+        change(*updated);
+        recordChange(id, current, rowOf(id));
+        working.rows.set(rowOf(id), updated, edit());
+        working.byId.assign(id.raw(), updated, edit());
+        retire(roster.replace(updated));
+        return true;
+    }
+
+    template <typename T, typename Change>
+    bool updateEmployee(const EmployeeId& id, EmployeeType type, Change change) {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        if(!changeEmployee<T>(id, type, change)) return false;
+        publish();
+        return true;
+    }
+
+    // Applies step's changes newest first and queues the step that reverses
+    // it on inverse. Restored employees are fresh clones: the recorded ones
+    // already sit in retire lists. Fails, changing nothing, if an ID coming
+    // back was claimed by a concurrent add.
+    bool applyStep(const HistoryStep& step, deque<HistoryStep>& inverse) {
+        auto returning = [this](const HistoryChange& change) { return change.restore && !liveEmployee(change.id); };
+        if(claimedIds) {
+            for(size_t i = 0; i < step.changes.size(); i++) {
+                if(!returning(step.changes[i]) || claimedIds->insert(step.changes[i].id)) continue;
+                for(size_t j = 0; j < i; j++) {
+                    if(returning(step.changes[j])) claimedIds->erase(step.changes[j].id);
+                }
+                return false;
+            }
+        }
+
+        HistoryStep reversed{ atomic_load(&published), {}, rowEpoch };
+        {
+            AllocScope scope(AllocCategory::Index);
+            reversed.changes.reserve(step.changes.size());
+        }
+        bool rowsValid = step.rowEpoch == rowEpoch;
+        for(auto change = step.changes.rbegin(); change != step.changes.rend(); ++change) {
+            uint32_t row = rowOf(change->id);
+            Employee* current = row == HandleTable::npos ? nullptr : roster.employees[row];
+            reversed.changes.push_back({ change->id, current, row });
+            Employee* restored = nullptr;
+            if(change->restore) {
+                AllocScope scope(AllocCategory::Employee);
+                restored = change->restore->clone();
+            }
+            // The name indexes follow the slot, so a rename goes through drop and store.
+            if(current && restored && current->getType() == restored->getType()
+               && current->getName() == restored->getName()) {
+                working.rows.set(row, restored, edit());
+                working.byId.assign(change->id.raw(), restored, edit());
+                retire(roster.replace(restored));
+                continue;
+            }
+            if(current) {
+                dropEmployee(change->id, row);
+                if(claimedIds && !restored) claimedIds->erase(change->id);
+            }
+            if(restored) storeEmployee(restored, rowsValid ? change->row : HandleTable::npos);
+        }
+        compactIfNeeded();
+        {
+            AllocScope scope(AllocCategory::Index);
+            inverse.push_back(std::move(reversed));
+        }
+        publish();
+        return true;
+    }
+
+    bool stepHistory(deque<HistoryStep>& from, deque<HistoryStep>& to) {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        if(from.empty() || !applyStep(from.back(), to)) return false;
+        from.pop_back();
+        return true;
+    }
+
+    const Employee* promptExistingEmployee() {
+        string input;
+        cout << "Enter ID: ";
+        getline(cin, input);
+        trimInPlace(input);
+        const Employee* emp = findEmployee(input);
+        if(!emp) cout << "Employee not found!\n\n";
+        return emp;
+    }
+
+    string getValidID() {
+        string input;
+        bool isValidInput = false;
+        while (!isValidInput) {
+            cout << "Enter ID: ";
+            getline(cin, input);
+            trimInPlace(input);
+
+            if(isValidIdText(input)) {
+                if(isIdUnique(input)) {
+                    isValidInput = true;
+                } else {
+                    cout << "Duplicate ID! Try again.\n";
+                }
+            } else {
+                cout << "Invalid ID! Use only letters and numbers.\n";
+            }
+        }
+        return input;
+    }
+
+    double getValidDouble(const string& prompt) {
+        string input;
+        double value = 0.0;
+        bool isValidInput = false;
+        while (!isValidInput) {
+            cout << prompt;
+            getline(cin, input);
+            trimInPlace(input);
+
+            bool valid = !input.empty();
+            int decimalPoints = 0;
+            bool hasDigit = false;
+
+            for(char c : input) {
+                if(c == '.') {
+                    if(++decimalPoints > 1) valid = false;
+                } else if(isdigit(c)) {
+                    hasDigit = true;
+                } else {
+                    valid = false;
+                }
+                if(!valid) break;
+            }
+
+            if(valid && hasDigit) {
+                try {
+                    value = stod(input);
+                    isValidInput = true;
+                } catch (const std::invalid_argument& e) {
+                    cout << "Invalid input! Please enter a valid number.\n";
+                } catch (const std::out_of_range& e) {
+                    cout << "Input out of range for a double.\n";
+                }
+            } else {
+                cout << "Invalid input! Use numbers with optional single decimal point.\n";
+            }
+        }
+        return value;
+    }
+
+    int getValidInt(const string& prompt) {
+        string input;
+        int value = 0;
+        bool isValidInput = false;
+        while (!isValidInput) {
+            cout << prompt;
+            getline(cin, input);
+            trimInPlace(input);
+
+            bool valid = !input.empty();
+            for(char c : input) {
+                if(!isdigit(c)) {
+                    valid = false;
+                    break;
+                }
+            }
+
+            if(valid) {
+                try {
+                    value = stoi(input);
+                    isValidInput = true;
+                } catch (const std::invalid_argument& e) {
+                    cout << "Invalid input! Please enter a valid integer.\n";
+                } catch (const std::out_of_range& e) {
+                    cout << "Input out of range for an integer.\n";
+                }
+            } else {
+                cout << "Invalid input! Please enter whole numbers only.\n";
+            }
+        }
+        return value;
+    }
+
+    string getValidName() {
+        string input;
+        bool isValidInput = false;
+        while (!isValidInput) {
+            cout << "Enter Name: ";
+            getline(cin, input);
+            trimInPlace(input);
+
+            if(isValidNameText(input)) {
+                isValidInput = true;
+            } else {
+                cout << "Invalid name! Use letters and single spaces between names.\n";
+            }
+        }
+        return input;
+    }
+
+public:
+    explicit PayrollSystem(bool concurrentIngest = false) {
+        if(concurrentIngest) claimedIds = make_unique<ConcurrentIdSet>();
+        publish();
+    }
+
+    void useScheduler(TaskScheduler* tasks) {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        scheduler = tasks;
+    }
+
+    // Current version for lock-free reading from any thread. Employees reached
+    // through it stay valid, and unchanged, for as long as it is held.
+    shared_ptr<const RosterSnapshot> snapshot() const {
+        return atomic_load(&published);
+    }
+
+    // A private what-if fork of the current pay columns. The columns are
+    // built in O(n) once per published version; each fork after that costs
+    // O(chunks), and its adjustments copy only the chunks they change.
+    PayrollScenario scenario() const {
+        shared_ptr<const RosterSnapshot> snap = snapshot();
+        lock_guard<mutex> lock(scenarioLock);
+        if(!scenarioRoot || scenarioRoot->version() != snap->version) {
+            AllocScope scope(AllocCategory::Index);
+            scenarioRoot = make_unique<const PayrollScenario>(*snap);
+        }
+        return *scenarioRoot;
+    }
+
+    void displayScenario() {
+        PayrollScenario raise = scenario();
+        raise.scale(EmployeeType::FullTime, PayrollScenario::Column::Rate,
+            1.0 + getValidDouble("Full-time salary raise %: ") / 100.0);
+        raise.scale(EmployeeType::PartTime, PayrollScenario::Column::Rate,
+            1.0 + getValidDouble("Part-time hourly rate raise %: ") / 100.0);
+        raise.scale(EmployeeType::Contractual, PayrollScenario::Column::Rate,
+            1.0 + getValidDouble("Contract payment raise %: ") / 100.0);
+        PayrollTotals current = scenario().totals(scheduler);
+        PayrollTotals projected = raise.totals(scheduler);
+        cout << "\nWhat-if Raise Scenario ---\n";
+        for(size_t t = 0; t < static_cast<size_t>(EmployeeType::Count); t++) {
+            cout << employeeTypeName(static_cast<EmployeeType>(t)) << ": $" << current.byType[t].value()
+                 << " -> $" << projected.byType[t].value() << "\n";
+        }
+        cout << "Total Payroll: $" << current.total.value() << " -> $" << projected.total.value()
+             << " (+$" << projected.total.value() - current.total.value() << ")\n\n";
+    }
+
+    // Pays every employee on the roster for period and records it. Periods
+    // only move forward; false if period has already passed.
+    bool runPayroll(uint32_t period) {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        return payHistory.record(period, *atomic_load(&published));
+    }
+
+    bool runPayroll() {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        return runPayroll(payHistory.upcomingPeriod());
+    }
+
+    uint32_t upcomingPeriod() const {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        return payHistory.upcomingPeriod();
+    }
+
+    // Total paid in each period of [from, to), in cents.
+    vector<int64_t> totalsByPeriod(uint32_t from, uint32_t to) const {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        return payHistory.totalsByPeriod(from, to, scheduler);
+    }
+
+    int64_t paidTo(const EmployeeId& id, uint32_t from, uint32_t to) const {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        return payHistory.paidTo(id, from, to);
+    }
+
+    void displayPayRuns() {
+        cout << "1. Run Payroll for Period " << upcomingPeriod() << "\n";
+        cout << "2. Totals per Period\n";
+        cout << "3. Employee Pay History\n";
+        int choice = getValidInt("Choice: ");
+        switch(choice) {
+            case 1: {
+                uint32_t period = upcomingPeriod();
+                runPayroll(period);
+                vector<int64_t> total = totalsByPeriod(period, period + 1);
+                cout << "Period " << period << " paid: $" << total[0] / 100.0 << "\n\n";
+                break;
+            }
+            case 2: {
+                uint32_t to = upcomingPeriod();
+                vector<int64_t> totals = totalsByPeriod(0, to);
+                if(totals.empty()) cout << "No pay runs yet!\n";
+                for(uint32_t p = 0; p < to; p++) cout << "Period " << p << ": $" << totals[p] / 100.0 << "\n";
+                cout << "\n";
+                break;
+            }
+            case 3: {
+                const Employee* emp = promptExistingEmployee();
+                if(!emp) return;
+                lock_guard<recursive_mutex> lock(rosterLock);
+                payHistory.forEachRun(emp->getId(), [](uint32_t start, uint32_t length, int64_t cents) {
+                    cout << "Periods " << start << "-" << start + length - 1 << ": $" << cents / 100.0 << " per period\n";
+                });
+                cout << "Total paid: $" << payHistory.paidTo(emp->getId(), 0, payHistory.upcomingPeriod()) / 100.0 << "\n\n";
+                break;
+            }
+            default:
+                cout << "Invalid choice!\n\n";
+        }
+    }
+
+    // Sets hoursWorked from aggregated timesheets (rounded to the nearest
+    // hour) for every part-time employee with a completed shift in them,
+    // under one lock with one publish and one undo step. Other IDs are
+    // counted, not changed.
+    TimesheetAggregator::Summary applyTimesheet(const TimesheetAggregator& timesheet) {
+        TimesheetAggregator::Summary summary = timesheet.result();
+        lock_guard<recursive_mutex> lock(rosterLock);
+        timesheet.forEachEmployee([&](const EmployeeId& id, int64_t seconds, bool worked) {
+            const Employee* emp = liveEmployee(id);
+            if(!emp) {
+                summary.notOnRoster++;
+                return;
+            }
+            if(emp->getType() != EmployeeType::PartTime) {
+                summary.notPartTime++;
+                return;
+            }
+            if(!worked) return; // only an open clock-in, or stray clock-outs
+            int hours = static_cast<int>(min<int64_t>((seconds + 1800) / 3600, numeric_limits<int>::max()));
+            if(static_cast<const PartTimeEmployee*>(emp)->getHoursWorked() == hours) return;
+            changeEmployee<PartTimeEmployee>(id, EmployeeType::PartTime,
+                [hours](PartTimeEmployee& partTime) { partTime.setHoursWorked(hours); });
+            summary.updated++;
+        });
+        if(summary.updated > 0) publish();
+        return summary;
+    }
+
+    // Reads and applies an event log; false if the file cannot be read.
+    bool importTimesheet(const string& path, TimesheetAggregator::Summary& summary) {
+        TimesheetAggregator timesheet(scheduler);
+        if(!timesheet.consumeFile(path)) return false;
+        summary = applyTimesheet(timesheet);
+        return true;
+    }
+
+    void displayTimesheetImport() {
+        string path;
+        cout << "Event file: ";
+        getline(cin, path);
+        trimInPlace(path);
+        TimesheetAggregator::Summary summary;
+        if(!importTimesheet(path, summary)) {
+            cout << "Cannot read " << path << "!\n\n";
+            return;
+        }
+        cout << summary.events << " events for " << summary.employees << " employees ("
+             << summary.malformed << " malformed lines, " << summary.unmatched << " unmatched clock events, "
+             << summary.openSessions << " still clocked in)\n";
+        cout << summary.updated << " part-time employees updated, " << summary.notOnRoster << " IDs not on the roster, "
+             << summary.notPartTime << " not part-time\n\n";
+    }
+
+    // Sets each listed contractor's projectsCompleted to their distinct
+    // completions and paymentPerProject to the average amount, so salary is
+    // the ledger total. Values are set, not added, so applying the same
+    // ledger twice is harmless. One lock, one publish, one undo step.
+    ProjectLedger::Summary applyLedger(const ProjectLedger& ledger) {
+        ProjectLedger::Summary summary = ledger.result();
+        lock_guard<recursive_mutex> lock(rosterLock);
+        ledger.forEachContractor([&](const EmployeeId& id, int projects, int64_t cents) {
+            const Employee* emp = liveEmployee(id);
+            if(!emp) {
+                summary.notOnRoster++;
+                return;
+            }
+            if(emp->getType() != EmployeeType::Contractual) {
+                summary.notContractual++;
+                return;
+            }
+            double payment = cents / 100.0 / projects;
+            const ContractualEmployee* contractor = static_cast<const ContractualEmployee*>(emp);
+            if(contractor->getProjectsCompleted() == projects && contractor->getPaymentPerProject() == payment) return;
+            changeEmployee<ContractualEmployee>(id, EmployeeType::Contractual,
+                [projects, payment](ContractualEmployee& contractual) {
+                    contractual.setProjectsCompleted(projects);
+                    contractual.setPaymentPerProject(payment);
+                });
+            summary.updated++;
+        });
+        if(summary.updated > 0) publish();
+        return summary;
+    }
+
+    // Reads and applies a ledger; false if it or a spill file cannot be used.
+    bool importLedger(const string& path, ProjectLedger::Summary& summary) {
+        ProjectLedger ledger;
+        if(!ledger.ingestFile(path)) return false;
+        summary = applyLedger(ledger);
+        return true;
+    }
+
+    void displayLedgerImport() {
+        string path;
+        cout << "Ledger file: ";
+        getline(cin, path);
+        trimInPlace(path);
+        ProjectLedger::Summary summary;
+        if(!importLedger(path, summary)) {
+            cout << "Cannot read " << path << "!\n\n";
+            return;
+        }
+        cout << summary.completions << " completions for " << summary.contractors << " employees ("
+             << summary.malformed << " malformed lines, " << summary.duplicates << " duplicates, "
+             << summary.conflicts << " conflicting amounts ignored)\n";
+        cout << summary.updated << " contractual employees updated, " << summary.notOnRoster << " IDs not on the roster, "
+             << summary.notContractual << " not contractual\n\n";
+    }
+
+    // Joins a delimited feed to the current snapshot by the ID in keyColumn
+    // (0 for the first), writing matched and unmatched rows to the given
+    // files; false if a file cannot be opened, read or written. Reads
+    // without the roster lock, so edits during a long join are not seen.
+    bool joinFeed(const string& path, char delimiter, size_t keyColumn, const string& matchedPath,
+                  const string& unmatchedPath, RosterJoin::Summary& summary) {
+        FILE* matched = fopen(matchedPath.c_str(), "wb");
+        FILE* unmatched = matched ? fopen(unmatchedPath.c_str(), "wb") : nullptr;
+        bool joined = false;
+        if(unmatched) {
+            RosterJoin join(snapshot(), scheduler, delimiter, keyColumn);
+            joined = join.joinFile(path, matched, unmatched);
+            summary = join.result();
+        }
+        if(matched) joined = fclose(matched) == 0 && joined;
+        if(unmatched) joined = fclose(unmatched) == 0 && joined;
+        return joined;
+    }
+
+    void displayJoin() {
+        string path, delimiter, matchedPath, unmatchedPath;
+        cout << "Feed file: ";
+        getline(cin, path);
+        trimInPlace(path);
+        cout << "Delimiter (blank for comma, \"tab\" for tab): ";
+        getline(cin, delimiter);
+        trimInPlace(delimiter);
+        int column = getValidInt("Employee ID column (1 for the first): ");
+        cout << "Matched rows file: ";
+        getline(cin, matchedPath);
+        trimInPlace(matchedPath);
+        cout << "Unmatched rows file: ";
+        getline(cin, unmatchedPath);
+        trimInPlace(unmatchedPath);
+        char separator = delimiter.empty() ? ',' : delimiter == "tab" ? '\t' : delimiter[0];
+        RosterJoin::Summary summary;
+        if(!joinFeed(path, separator, column > 0 ? column - 1 : 0, matchedPath, unmatchedPath, summary)) {
+            cout << "Cannot join " << path << "!\n\n";
+            return;
+        }
+        cout << summary.rows << " rows: " << summary.matched << " matched, " << summary.unmatched << " unmatched ("
+             << summary.unkeyed << " without a valid ID)\n\n";
+    }
+
+    // Writes the current snapshot as a roster file, sorted by ID.
+    bool saveRoster(const string& path) const {
+        shared_ptr<const RosterSnapshot> pinned = snapshot();
+        vector<const Employee*> employees = orderedEmployees(ReportOrder::IdAscending);
+        FILE* file = fopen(path.c_str(), "wb");
+        if(!file) return false;
+        const size_t grain = RosterSnapshot::parallelGrain;
+        vector<string> parts((employees.size() + grain - 1) / grain);
+        auto render = [&](size_t first, size_t last) {
+            AllocScope scope(AllocCategory::Report);
+            for(size_t c = first; c < last; c++) {
+                for(size_t i = c * grain; i < min(employees.size(), (c + 1) * grain); i++) appendRosterLine(parts[c], employees[i]);
+            }
+        };
+        if(scheduler) scheduler->parallelFor(size_t(0), parts.size(), 1, render);
+        else render(0, parts.size());
+        bool written = true;
+        for(const string& part : parts) written = fwrite(part.data(), 1, part.size(), file) == part.size() && written;
+        return fclose(file) == 0 && written;
+    }
+
+    struct RosterChanges {
+        size_t added = 0;
+        size_t removed = 0;
+        size_t changed = 0;
+        size_t malformed = 0;
+        size_t rejected = 0; // adds of IDs in use, removals and changes of absent ones
+    };
+
+    // Applies a change set (or loads a roster file) under one lock, with one
+    // publish and one undo step. Rejected lines are counted and skipped.
+    // False if the file cannot be read.
+    bool applyRosterChanges(const string& path, RosterChanges& summary) {
+        FILE* file = fopen(path.c_str(), "rb");
+        if(!file) return false;
+        lock_guard<recursive_mutex> lock(rosterLock);
+        LineReader reader(file);
+        string_view line;
+        while(reader.next(line)) {
+            if(line.empty()) continue;
+            char kind = line[0] == '-' || line[0] == '~' || line[0] == '+' ? line[0] : '+';
+            if(kind == line[0]) line.remove_prefix(1);
+            if(kind == '-') {
+                EmployeeId id;
+                uint32_t row = EmployeeId::lookup(line, id) ? rowOf(id) : HandleTable::npos;
+                if(row == HandleTable::npos) {
+                    summary.rejected++;
+                    continue;
+                }
+                recordChange(id, dropEmployee(id, row), row);
+                if(claimedIds) claimedIds->erase(id);
+                summary.removed++;
+                continue;
+            }
+            Employee* emp = parseRosterLine(line);
+            if(!emp) {
+                summary.malformed++;
+                continue;
+            }
+            EmployeeId id = emp->getId();
+            uint32_t row = rowOf(id);
+            if(kind == '+' ? row != HandleTable::npos || (claimedIds && !claimedIds->insert(id)) : row == HandleTable::npos) {
+                delete emp;
+                summary.rejected++;
+                continue;
+            }
+            if(kind == '+') {
+                recordChange(id, nullptr, HandleTable::npos);
+                storeEmployee(emp);
+                summary.added++;
+                continue;
+            }
+            Employee* current = roster.employees[row];
+            recordChange(id, current, row);
+            if(current->getType() == emp->getType() && current->getName() == emp->getName()) {
+                working.rows.set(row, emp, edit());
+                working.byId.assign(id.raw(), emp, edit());
+                retire(roster.replace(emp));
+            } else {
+                // The name indexes follow the slot, so a rename re-inserts.
+                dropEmployee(id, row);
+                storeEmployee(emp, row);
+            }
+            summary.changed++;
+        }
+        bool read = !reader.failed();
+        fclose(file);
+        compactIfNeeded();
+        if(summary.added + summary.removed + summary.changed > 0) publish();
+        return read;
+    }
+
+    void displayRosterFiles() {
+        cout << "1. Save Roster File\n";
+        cout << "2. Load Roster File or Apply Change Set\n";
+        cout << "3. Diff Two Roster Files\n";
+        cout << "4. Merge Roster Files\n";
+        int choice = getValidInt("Choice: ");
+        auto prompt = [this](const char* text) {
+            string path;
+            cout << text;
+            getline(cin, path);
+            trimInPlace(path);
+            return path;
+        };
+        switch(choice) {
+            case 1: {
+                string path = prompt("Roster file: ");
+                cout << (saveRoster(path) ? "Saved " : "Cannot write ") << path << "\n\n";
+                break;
+            }
+            case 2: {
+                string path = prompt("Roster or change set file: ");
+                RosterChanges summary;
+                if(!applyRosterChanges(path, summary)) {
+                    cout << "Cannot read " << path << "!\n\n";
+                    break;
+                }
+                cout << summary.added << " added, " << summary.removed << " removed, " << summary.changed << " changed ("
+                     << summary.malformed << " malformed lines, " << summary.rejected << " rejected)\n\n";
+                break;
+            }
+            case 3: {
+                string before = prompt("Earlier roster file: ");
+                string after = prompt("Later roster file: ");
+                string output = prompt("Change set file: ");
+                FILE* changes = fopen(output.c_str(), "wb");
+                RosterDiff diff;
+                bool done = changes && diffRosterFiles(before, after, changes, diff, size_t(256) << 20, scheduler);
+                if(changes) done = fclose(changes) == 0 && done;
+                if(!done) {
+                    cout << "Cannot diff " << before << " and " << after << "!\n\n";
+                    break;
+                }
+                cout << diff.added << " added, " << diff.removed << " removed, " << diff.payChanges << " pay changes, "
+                     << diff.renamed << " renamed, " << diff.unchanged << " unchanged\n\n";
+                break;
+            }
+            case 4: {
+                vector<string> inputs;
+                for(string path; !(path = prompt("Roster file (blank to finish): ")).empty();) inputs.push_back(path);
+                string output = prompt("Merged roster file: ");
+                FILE* merged = fopen(output.c_str(), "wb");
+                RosterMerge merge;
+                bool done = merged && mergeRosterFiles(inputs, merged, merge, size_t(256) << 20, scheduler);
+                if(merged) done = fclose(merged) == 0 && done;
+                if(!done) {
+                    cout << "Cannot merge into " << output << "!\n\n";
+                    break;
+                }
+                cout << merge.employees << " employees from " << inputs.size() << " files (" << merge.duplicates
+                     << " duplicates, " << merge.conflicts << " conflicts kept from the earlier file)\n\n";
+                break;
+            }
+            default:
+                cout << "Invalid choice!\n\n";
+        }
+    }
+
+    void displayProjection() {
+        ProjectionModel model;
+        int trials = getValidInt("Trials (0 for 2000): ");
+        if(trials > 0) model.trials = trials;
+        ProjectionResult result = projectPayroll(scenario(), model, scheduler);
+        cout << "\nNext-Year Payroll Projection ---\n";
+        cout << "Mean: $" << result.mean << "\n";
+        for(size_t i = 0; i < 5; i++) {
+            cout << "P" << ProjectionResult::levels[i] << ": $" << result.percentiles[i] << "\n";
+        }
+        cout << model.trials << " trials, " << result.employeePeriods << " simulated employee-periods\n\n";
+    }
+
+    string trim(const string& str) {
+        string result = str;
+        trimInPlace(result);
+        return result;
+    }
+
+    // Trims without building a new string; the buffer is kept for the caller.
+    void trimInPlace(string& str) {
+        size_t end = str.length();
+        while(end > 0 && isspace(static_cast<unsigned char>(str[end - 1]))) end--;
+        str.erase(end);
+
+        size_t start = 0;
+        while(start < str.length() && isspace(static_cast<unsigned char>(str[start]))) start++;
+        str.erase(0, start);
+    }
+
+    void addEmployee(int type) {
+        EmployeeId id;
+        string name;
+        {
+            AllocScope scope(AllocCategory::Input);
+            id = EmployeeId::fromString(getValidID());
+            name = getValidName();
+        }
+
+        Employee* emp = nullptr;
+        switch(type) {
+            case 1: {
+                double salary = getValidDouble("Monthly Salary: $");
+                AllocScope scope(AllocCategory::Employee);
+                emp = new FullTimeEmployee(id, name, salary);
+                break;
+            }
+            case 2: {
+                double rate = getValidDouble("Hourly Rate: $");
+                int hours = getValidInt("Hours Worked: ");
+                AllocScope scope(AllocCategory::Employee);
+                emp = new PartTimeEmployee(id, name, rate, hours);
+                break;
+            }
+            case 3: {
+                double rate = getValidDouble("Payment Per Project: $");
+                int projects = getValidInt("Projects Completed: ");
+                AllocScope scope(AllocCategory::Employee);
+                emp = new ContractualEmployee(id, name, rate, projects);
+                break;
+            }
+        }
+        if(!emp) return;
+        cout << (addEmployee(emp) ? "Employee added!\n\n" : "ID already in use!\n\n");
+    }
+
+    // Takes ownership of emp. Rejects (and frees) records whose ID is already in use.
+    bool addEmployee(Employee* emp) {
+        if(claimedIds && !claimedIds->insert(emp->getId())) {
+            delete emp;
+            return false;
+        }
+        lock_guard<recursive_mutex> lock(rosterLock);
+        if(!isIdUnique(emp->getId())) {
+            delete emp;
+            return false;
+        }
+        recordChange(emp->getId(), nullptr, HandleTable::npos);
+        storeEmployee(emp);
+        publish();
+        return true;
+    }
+
+    // Builds the employee in place from the given fields; the name is interned
+    // directly from the caller's buffer. Returns nullptr if the ID is already in use.
+    template <typename T, typename... Args>
+    T* emplaceEmployee(EmployeeId id, string_view name, Args&&... args) {
+        if(claimedIds && !claimedIds->insert(id)) return nullptr;
+        lock_guard<recursive_mutex> lock(rosterLock);
+        if(!isIdUnique(id)) return nullptr;
+        T* emp;
+        {
+            AllocScope scope(AllocCategory::Employee);
+            emp = new T(id, name, std::forward<Args>(args)...);
+        }
+        recordChange(id, nullptr, HandleTable::npos);
+        storeEmployee(emp);
+        publish();
+        return emp;
+    }
+
+    // Checks a batch without committing it: negative pay, IDs repeated within
+    // the batch (every occurrence after the first) and IDs already in use.
+    vector<BatchIssue> validateBatch(const PayrollBatch& batch) const {
+        vector<BatchIssue> issues;
+        for(size_t i = 0; i < batch.size(); i++) {
+            if(!(batch.at(i)->getSalary() >= 0)) issues.push_back({ i, batch.at(i)->getId(), "negative or invalid pay" });
+        }
+
+        // Sorting by packed ID puts repeats next to each other; radixSort is
+        // stable, so the first occurrence leads each run.
+        vector<SortEntry> ids(batch.size());
+        for(size_t i = 0; i < batch.size(); i++) ids[i] = { batch.at(i)->getId().raw(), static_cast<uint32_t>(i) };
+        radixSort(ids);
+        for(size_t i = 1; i < ids.size(); i++) {
+            if(ids[i].key == ids[i - 1].key) {
+                issues.push_back({ ids[i].row, batch.at(ids[i].row)->getId(), "duplicate ID within batch" });
+            }
+        }
+
+        lock_guard<recursive_mutex> lock(rosterLock);
+        for(size_t i = 0; i < batch.size(); i++) {
+            if(!isIdUnique(batch.at(i)->getId())) issues.push_back({ i, batch.at(i)->getId(), "ID already in use" });
+        }
+        sort(issues.begin(), issues.end(), [](const BatchIssue& a, const BatchIssue& b) { return a.index < b.index; });
+        return issues;
+    }
+
+    // All-or-nothing: validates the whole batch, then adds every employee
+    // under one lock with one storage reservation and one snapshot
+    // publication. Returns the problems found; empty means committed, and
+    // the batch is left empty.
+    vector<BatchIssue> commitBatch(PayrollBatch& batch) {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        vector<BatchIssue> issues = validateBatch(batch);
+        if(!issues.empty()) return issues;
+        return commitValidated(batch);
+    }
+
+private:
+    // The rest of commitBatch, for a batch validated under the lock the
+    // caller still holds.
+    vector<BatchIssue> commitValidated(PayrollBatch& batch) {
+        vector<BatchIssue> issues;
+        if(claimedIds) {
+            // Unlocked adds may have claimed an ID since validation; back out.
+            for(size_t i = 0; i < batch.size(); i++) {
+                if(claimedIds->insert(batch.at(i)->getId())) continue;
+                for(size_t j = 0; j < i; j++) claimedIds->erase(batch.at(j)->getId());
+                issues.push_back({ i, batch.at(i)->getId(), "ID claimed concurrently" });
+                return issues;
+            }
+        }
+
+        size_t needed = roster.employees.size() + batch.size();
+        if(needed > roster.employees.capacity()) roster.reserve(max(needed, roster.employees.capacity() * 2));
+        for(Employee* emp : batch.staged) {
+            recordChange(emp->getId(), nullptr, HandleTable::npos);
+            storeEmployee(emp);
+        }
+        batch.staged.clear();
+        publish();
+        return issues;
+    }
+
+public:
+    // Lets bulk callers size storage once before a run of emplaceEmployee calls.
+    void reserve(size_t count) {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        roster.reserve(count);
+        if(claimedIds) claimedIds->reserve(count);
+    }
+
+    // Storage rows include tombstones: employeeAt returns nullptr for removed rows.
+    size_t rowCount() const {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        return roster.employees.size();
+    }
+
+    const Employee* employeeAt(uint32_t row) const {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        return roster.employees[row];
+    }
+
+    bool updateMonthlySalary(const EmployeeId& id, double salary) {
+        return updateEmployee<FullTimeEmployee>(id, EmployeeType::FullTime,
+            [&](FullTimeEmployee& emp) { emp.setSalary(salary); });
+    }
+
+    bool updateHourlyRate(const EmployeeId& id, double rate) {
+        return updateEmployee<PartTimeEmployee>(id, EmployeeType::PartTime,
+            [&](PartTimeEmployee& emp) { emp.setHourlyRate(rate); });
+    }
+
+    bool updateHoursWorked(const EmployeeId& id, int hours) {
+        return updateEmployee<PartTimeEmployee>(id, EmployeeType::PartTime,
+            [&](PartTimeEmployee& emp) { emp.setHoursWorked(hours); });
+    }
+
+    bool updatePaymentPerProject(const EmployeeId& id, double payment) {
+        return updateEmployee<ContractualEmployee>(id, EmployeeType::Contractual,
+            [&](ContractualEmployee& emp) { emp.setPaymentPerProject(payment); });
+    }
+
+    bool updateProjectsCompleted(const EmployeeId& id, int projects) {
+        return updateEmployee<ContractualEmployee>(id, EmployeeType::Contractual,
+            [&](ContractualEmployee& emp) { emp.setProjectsCompleted(projects); });
+    }
+
+    // Tombstones the employee in O(1) plus index upkeep; storage rows are
+    // compacted once enough of them are dead. Outstanding handles go stale.
+    bool removeEmployee(const EmployeeId& id) {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        uint32_t row = rowOf(id);
+        if(row == HandleTable::npos) return false;
+        recordChange(id, dropEmployee(id, row), row);
+        if(claimedIds) claimedIds->erase(id);
+        compactIfNeeded();
+        publish();
+        return true;
+    }
+
+    // Keeps the last steps operations (an add, update, removal or batch each)
+    // for undo and redo; 0 turns history off. Any new change clears redo.
+    void keepHistory(size_t steps) {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        historyLimit = steps;
+        while(undoSteps.size() > steps) undoSteps.pop_front();
+        if(steps == 0) redoSteps.clear();
+    }
+
+    // Both cost O(log n) per employee the step touched. Employees come back in
+    // their old rows unless compaction has run since; handles to them go stale.
+    bool undo() { return stepHistory(undoSteps, redoSteps); }
+    bool redo() { return stepHistory(redoSteps, undoSteps); }
+
+    size_t undoDepth() const {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        return undoSteps.size();
+    }
+
+    size_t redoDepth() const {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        return redoSteps.size();
+    }
+
+    void displayUndo() { cout << (undo() ? "Last change undone!\n\n" : "Nothing to undo!\n\n"); }
+    void displayRedo() { cout << (redo() ? "Change redone!\n\n" : "Nothing to redo!\n\n"); }
+
+    // Stable reference for indexes, caches and callers; invalid after removal.
+    bool handleOf(const EmployeeId& id, EmployeeHandle& handle) const {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        uint32_t slot = roster.idIndex.find(id);
+        if(slot == IdIndex::npos) return false;
+        handle = roster.handles.handleOf(slot);
+        return true;
+    }
+
+    // nullptr if the handle is stale.
+    const Employee* resolve(EmployeeHandle handle) const {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        return roster.resolve(handle);
+    }
+
+    void displayUpdateEmployee() {
+        const Employee* emp = promptExistingEmployee();
+        if(!emp) return;
+        EmployeeId id = emp->getId();
+        bool updated = false;
+        switch(emp->getType()) {
+            case EmployeeType::FullTime:
+                updated = updateMonthlySalary(id, getValidDouble("New Monthly Salary: $"));
+                break;
+            // One update each, so a single undo reverts the whole edit.
+            case EmployeeType::PartTime: {
+                double rate = getValidDouble("New Hourly Rate: $");
+                int hours = getValidInt("New Hours Worked: ");
+                updated = updateEmployee<PartTimeEmployee>(id, EmployeeType::PartTime,
+                    [&](PartTimeEmployee& emp) { emp.setHourlyRate(rate); emp.setHoursWorked(hours); });
+                break;
+            }
+            case EmployeeType::Contractual: {
+                double payment = getValidDouble("New Payment Per Project: $");
+                int projects = getValidInt("New Projects Completed: ");
+                updated = updateEmployee<ContractualEmployee>(id, EmployeeType::Contractual,
+                    [&](ContractualEmployee& emp) { emp.setPaymentPerProject(payment); emp.setProjectsCompleted(projects); });
+                break;
+            }
+            default: break;
+        }
+        cout << (updated ? "Employee updated!\n\n" : "Update failed!\n\n");
+    }
+
+    void displayRemoveEmployee() {
+        const Employee* emp = promptExistingEmployee();
+        if(!emp) return;
+        cout << (removeEmployee(emp->getId()) ? "Employee removed!\n\n" : "Remove failed!\n\n");
+    }
+
+    // Reads the latest snapshot. From other threads, hold a snapshot() instead
+    // so the result cannot be removed and freed while in use.
+    const Employee* findEmployee(const EmployeeId& id) const {
+        return snapshot()->find(id);
+    }
+
+    const Employee* findEmployee(const string& id) const {
+        EmployeeId key;
+        return EmployeeId::lookup(id, key) ? findEmployee(key) : nullptr;
+    }
+
+    size_t employeeCount() const { return snapshot()->employeeCount(); }
+
+    double totalPayroll() const { return snapshot()->totalPayroll(scheduler); }
+
+    size_t employeeCount(EmployeeType type) const { return snapshot()->employeeCount(type); }
+
+    PayrollTotals payrollTotals() const { return snapshot()->payrollTotals(scheduler); }
+
+    // Aggregates over one employment type visit only that type's rows. Each
+    // bitmap container is summed on its own and merged in container order,
+    // so the result is reproducible for any worker count.
+    double totalPayroll(EmployeeType type) const {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        const RoaringBitmap& slots = roster.typeIndex[static_cast<size_t>(type)];
+        auto sum = [&](size_t first, size_t last) {
+            CompensatedSum total;
+            auto visit = [&](uint32_t slot) { total.add(roster.bySlot(slot)->getSalary()); };
+            for(size_t c = first; c < last; c++) slots.forEachInContainer(c, visit);
+            return total;
+        };
+        if(scheduler && slots.size() > RosterSnapshot::parallelGrain) {
+            return scheduler->parallelReduce(size_t(0), slots.containerCount(), 1, CompensatedSum(), sum,
+                [](CompensatedSum merged, const CompensatedSum& part) { merged.add(part); return merged; }).value();
+        }
+        CompensatedSum total;
+        for(size_t c = 0; c < slots.containerCount(); c++) total.add(sum(c, c + 1));
+        return total.value();
+    }
+
+    void renderPayrollReport(string& out, EmployeeType type) const {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        AllocScope scope(AllocCategory::Report);
+        out.clear();
+        const RoaringBitmap& slots = roster.typeIndex[static_cast<size_t>(type)];
+        if(slots.size() == 0) {
+            out += "No "; out += employeeTypeName(type); out += " employees in system!\n\n";
+            return;
+        }
+        out += "\n"; out += employeeTypeName(type); out += " Payroll Report ---\n";
+        slots.forEach([&](uint32_t slot) { roster.bySlot(slot)->render(out); });
+        out += "Total "; out += employeeTypeName(type); out += " Payroll: $";
+        appendNumber(out, totalPayroll(type));
+        out += "\n\n";
+    }
+
+    void displayTypeReport() {
+        cout << "1. Full-time\n";
+        cout << "2. Part-time\n";
+        cout << "3. Contractual\n";
+        int choice = getValidInt("Employment Type: ");
+        if(choice < 1 || choice > 3) {
+            cout << "Invalid employment type!\n\n";
+            return;
+        }
+        renderPayrollReport(reportBuffer, static_cast<EmployeeType>(choice - 1));
+        cout << reportBuffer;
+    }
+
+    // Renders the whole report into out, reusing its capacity across calls.
+    void renderPayrollReport(string& out) const {
+        snapshot()->renderPayrollReport(out, scheduler);
+    }
+
+    void displayPayrollReport() const {
+        renderPayrollReport(reportBuffer);
+        cout << reportBuffer;
+    }
+
+    vector<SortEntry> sortKeys(ReportOrder order) const {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        auto keyFor = [order](const Employee* emp, uint32_t row) -> uint64_t {
+            switch(order) {
+                case ReportOrder::SalaryDescending: return ~orderedKey(emp->getSalary());
+                case ReportOrder::SalaryAscending: return orderedKey(emp->getSalary());
+                case ReportOrder::IdAscending: return emp->getId().sortKey();
+                default: return row;
+            }
+        };
+        vector<SortEntry> entries;
+        size_t rows = roster.employees.size();
+        if(scheduler && rows > RosterSnapshot::parallelGrain) {
+            // Every row gets a slot; tombstones are marked and squeezed out after.
+            entries.resize(rows);
+            scheduler->parallelFor(0, rows, RosterSnapshot::parallelGrain, [&](size_t begin, size_t end) {
+                for(size_t row = begin; row < end; row++) {
+                    const Employee* emp = roster.employees[row];
+                    entries[row] = emp ? SortEntry{ keyFor(emp, uint32_t(row)), uint32_t(row) }
+                                       : SortEntry{ 0, HandleTable::npos };
+                }
+            });
+            if(roster.deadCount > 0) {
+                entries.erase(remove_if(entries.begin(), entries.end(),
+                    [](const SortEntry& entry) { return entry.row == HandleTable::npos; }), entries.end());
+            }
+            return entries;
+        }
+        entries.reserve(roster.liveCount());
+        for(uint32_t row = 0; row < rows; row++) {
+            const Employee* emp = roster.employees[row];
+            if(emp) entries.push_back({ keyFor(emp, row), row });
+        }
+        return entries;
+    }
+
+    // Long IDs only contribute their first characters to the sort key; order
+    // runs of equal keys that contain one by the full ID.
+    void resolveIdTies(vector<SortEntry>& entries) const {
+        size_t start = 0;
+        while(start < entries.size()) {
+            size_t end = start + 1;
+            bool needsTieBreak = !roster.employees[entries[start].row]->getId().isInline();
+            while(end < entries.size() && entries[end].key == entries[start].key) {
+                if(!roster.employees[entries[end].row]->getId().isInline()) needsTieBreak = true;
+                end++;
+            }
+            if(needsTieBreak && end - start > 1) {
+                stable_sort(entries.begin() + start, entries.begin() + end,
+                    [this](const SortEntry& a, const SortEntry& b) {
+                        return roster.employees[a.row]->getId() < roster.employees[b.row]->getId();
+                    });
+            }
+            start = end;
+        }
+    }
+
+    // Storage rows in report order; a non-zero limit keeps only the first limit
+    // rows, selected with a bounded heap instead of a full sort.
+    vector<uint32_t> orderedRows(ReportOrder order, size_t limit = 0) const {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        vector<SortEntry> entries = sortKeys(order);
+        if(order != ReportOrder::Insertion) {
+            if(limit > 0 && limit < entries.size() / 8) {
+                entries = smallestEntries(entries, limit);
+            } else {
+                radixSort(entries);
+            }
+            if(order == ReportOrder::IdAscending) resolveIdTies(entries);
+        }
+        if(limit > 0 && limit < entries.size()) entries.resize(limit);
+
+        vector<uint32_t> rows(entries.size());
+        for(size_t i = 0; i < entries.size(); i++) rows[i] = entries[i].row;
+        return rows;
+    }
+
+    // orderedRows resolved to employees under one lock. Pin a snapshot() first
+    // if writers may remove them while the caller uses the result.
+    vector<const Employee*> orderedEmployees(ReportOrder order, size_t limit = 0) const {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        vector<uint32_t> rows = orderedRows(order, limit);
+        vector<const Employee*> employees(rows.size());
+        for(size_t i = 0; i < rows.size(); i++) employees[i] = roster.employees[rows[i]];
+        return employees;
+    }
+
+    void renderSortedReport(string& out, ReportOrder order, size_t limit = 0) const {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        vector<uint32_t> rows = orderedRows(order, limit);
+        AllocScope scope(AllocCategory::Report);
+        out.clear();
+        if(rows.empty()) {
+            out += "No employees in system!\n\n";
+            return;
+        }
+        out += "\nEmployee Payroll Report ---\n";
+        for(uint32_t row : rows) {
+            roster.employees[row]->render(out);
+        }
+    }
+
+    void displaySortedReport() {
+        cout << "1. Highest Salary First\n";
+        cout << "2. Lowest Salary First\n";
+        cout << "3. By Employee ID\n";
+        cout << "4. Top Earners\n";
+        int choice = getValidInt("Order: ");
+        switch(choice) {
+            case 1: renderSortedReport(reportBuffer, ReportOrder::SalaryDescending); break;
+            case 2: renderSortedReport(reportBuffer, ReportOrder::SalaryAscending); break;
+            case 3: renderSortedReport(reportBuffer, ReportOrder::IdAscending); break;
+            case 4: {
+                int count = getValidInt("How many: ");
+                renderSortedReport(reportBuffer, ReportOrder::SalaryDescending, count > 0 ? count : 1);
+                break;
+            }
+            default:
+                cout << "Invalid report order!\n\n";
+                return;
+        }
+        cout << reportBuffer;
+    }
+
+    vector<const Employee*> findBySalaryRange(double low, double high) const {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        vector<const Employee*> matches;
+        for(uint32_t slot : roster.salaryIndex.range(low, high)) matches.push_back(roster.bySlot(slot));
+        return matches;
+    }
+
+    size_t countBySalaryRange(double low, double high) const {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        return roster.salaryIndex.countInRange(low, high);
+    }
+
+    void displaySalaryRange() {
+        double low = getValidDouble("Minimum Salary: $");
+        double high = getValidDouble("Maximum Salary: $");
+        vector<const Employee*> matches = findBySalaryRange(low, high);
+        if(matches.empty()) {
+            cout << "No employees in that salary range!\n\n";
+            return;
+        }
+        AllocScope scope(AllocCategory::Report);
+        reportBuffer.clear();
+        reportBuffer += "\nSalary Range Report ---\n";
+        for(const Employee* emp : matches) emp->render(reportBuffer);
+        cout << reportBuffer << matches.size() << " employee(s) found.\n\n";
+    }
+
+    vector<const Employee*> findByNamePrefix(string_view prefix, size_t limit = 0) const {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        vector<const Employee*> matches;
+        auto live = [this](EmployeeHandle handle) { return roster.handles.isValid(handle); };
+        for(uint32_t slot : roster.nameIndex.find(prefix, limit, live)) matches.push_back(roster.bySlot(slot));
+        return matches;
+    }
+
+    void displayNameSearch() {
+        string prefix;
+        cout << "Name starts with: ";
+        getline(cin, prefix);
+        trimInPlace(prefix);
+        if(prefix.empty()) {
+            cout << "Please enter part of a name.\n\n";
+            return;
+        }
+        vector<const Employee*> matches = findByNamePrefix(prefix);
+        if(matches.empty()) {
+            cout << "No matching employees!\n\n";
+            return;
+        }
+        AllocScope scope(AllocCategory::Report);
+        reportBuffer.clear();
+        reportBuffer += "\nName Search Results ---\n";
+        for(const Employee* emp : matches) emp->render(reportBuffer);
+        cout << reportBuffer << matches.size() << " employee(s) found.\n\n";
+    }
+
+    struct FuzzyResult {
+        const Employee* employee;
+        int distance;
+        double score;
+    };
+
+    vector<FuzzyResult> findByFuzzyName(string_view query, size_t limit = 10) const {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        vector<FuzzyResult> results;
+        for(const auto& match : roster.trigramIndex.search(query, limit)) {
+            results.push_back({ roster.bySlot(match.slot), match.distance, match.score });
+        }
+        return results;
+    }
+
+    void displayFuzzySearch() {
+        string query;
+        cout << "Name (approximate): ";
+        getline(cin, query);
+        trimInPlace(query);
+        if(query.empty()) {
+            cout << "Please enter a name.\n\n";
+            return;
+        }
+        vector<FuzzyResult> results = findByFuzzyName(query);
+        if(results.empty()) {
+            cout << "No similar names found!\n\n";
+            return;
+        }
+        AllocScope scope(AllocCategory::Report);
+        reportBuffer.clear();
+        reportBuffer += "\nFuzzy Search Results ---\n";
+        for(const auto& result : results) {
+            reportBuffer += "Score: ";
+            appendNumber(reportBuffer, result.score);
+            reportBuffer += " (";
+            appendNumber(reportBuffer, result.distance);
+            reportBuffer += " edit(s))\n";
+            result.employee->render(reportBuffer);
+        }
+        cout << reportBuffer;
+    }
+
+    void displayMemoryStats() const {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        NamePool::Stats names = NamePool::instance().stats();
+        cout << "\nMemory Statistics ---\n";
+        cout << "Employees: " << roster.liveCount() << " (" << roster.deadCount << " removed rows awaiting compaction, "
+             << compactions << " compactions run)\n";
+        cout << "Published version: " << working.version - 1 << " (" << retiring.size()
+             << " retire lists awaiting older snapshots)\n";
+        if(historyLimit) {
+            size_t retained = 0;
+            for(const auto& garbage : retiring) retained += garbage->items.size();
+            cout << "Undo history: " << undoSteps.size() << " steps, " << redoSteps.size() << " redo steps ("
+                 << retained << " superseded nodes and employees retained)\n";
+        }
+        cout << "Pay history: " << payHistory.runCount() << " runs for " << payHistory.payments() << " payments over "
+             << payHistory.periodsRecorded() << " periods, " << payHistory.memoryBytes() << " bytes\n";
+        cout << "Handle table: " << roster.handles.memoryBytes() << " bytes\n";
+        cout << "ID index: " << roster.idIndex.memoryBytes() << " bytes\n";
+        if(claimedIds) {
+            cout << "Concurrent ID set: " << claimedIds->memoryBytes() << " bytes ("
+                 << claimedIds->resizeCount() << " resizes)\n";
+        }
+        cout << "Name prefix index: " << roster.nameIndex.memoryBytes() << " bytes\n";
+        cout << "Trigram index: " << roster.trigramIndex.memoryBytes() << " bytes ("
+             << roster.trigramIndex.distinctNames() << " distinct names)\n";
+        for(size_t t = 0; t < static_cast<size_t>(EmployeeType::Count); t++) {
+            cout << employeeTypeName(static_cast<EmployeeType>(t)) << " bitmap: "
+                 << roster.typeIndex[t].size() << " rows, " << roster.typeIndex[t].memoryBytes() << " bytes\n";
+        }
+        cout << "Names interned: " << names.internCalls << " (" << names.uniqueNames << " unique, "
+             << names.requestedBytes << " characters)\n";
+        cout << "Name storage as strings: " << names.plainStringBytes << " bytes\n";
+        cout << "Name storage pooled: " << names.pooledBytes << " bytes ("
+             << names.arenaReserved << " bytes of arena reserved)\n";
+        if(names.plainStringBytes > 0) {
+            double saved = 100.0 * (1.0 - double(names.pooledBytes) / names.plainStringBytes);
+            cout << "Saved: " << saved << "%\n";
+        }
+        cout << "\n";
+    }
+
+    ~PayrollSystem() {
+        lock_guard<recursive_mutex> lock(rosterLock);
+        for(auto& emp : roster.employees) {
+            if(emp) retire(emp);
+        }
+        working.rows.clear(edit());
+        working.byId.clear(edit());
+        undoSteps.clear();
+        redoSteps.clear();
+        atomic_store(&published, shared_ptr<const RosterSnapshot>());
+    }
+};
+
+// Payroll split into independent shards by ID hash, so threads adding
+// different employees rarely contend: each shard has its own storage, indexes,
+// lock and snapshots. An ID always lives in the same shard, which keeps the
+// uniqueness check shard-local. Global queries combine the shards.
+class ShardedPayrollSystem {
+    vector<unique_ptr<PayrollSystem>> shards;
+
+public:
+    explicit ShardedPayrollSystem(size_t shardCount = 16) {
+        for(size_t i = 0; i < max<size_t>(shardCount, 1); i++) shards.push_back(make_unique<PayrollSystem>());
+    }
+
+    size_t shardCount() const { return shards.size(); }
+
+    // Upper hash bits pick the shard; the low bits stay spread for the
+    // shard's own hash tables.
+    size_t shardIndex(const EmployeeId& id) const {
+        return static_cast<size_t>((mixBits(id.raw()) >> 40) % shards.size());
+    }
+
+    PayrollSystem& shardFor(const EmployeeId& id) const { return *shards[shardIndex(id)]; }
+
+    PayrollSystem& shard(size_t index) const { return *shards[index]; }
+
+    void reserve(size_t count) {
+        for(auto& shard : shards) shard->reserve(count / shards.size() + 1);
+    }
+
+    template <typename T, typename... Args>
+    T* emplaceEmployee(EmployeeId id, string_view name, Args&&... args) {
+        return shardFor(id).emplaceEmployee<T>(id, name, std::forward<Args>(args)...);
+    }
+
+    bool addEmployee(Employee* emp) {
+        return shardFor(emp->getId()).addEmployee(emp);
+    }
+
+    bool removeEmployee(const EmployeeId& id) {
+        return shardFor(id).removeEmployee(id);
+    }
+
+    // Splits the batch by shard and commits each part with one publication
+    // per shard. The touched shards are locked in index order for the whole
+    // commit, so it is all-or-nothing like PayrollSystem::commitBatch; issue
+    // indexes refer to the whole batch.
+    vector<BatchIssue> commitBatch(PayrollBatch& batch) {
+        vector<PayrollBatch> parts(shards.size());
+        vector<vector<size_t>> positions(shards.size());
+        for(size_t i = 0; i < batch.staged.size(); i++) {
+            size_t shard = shardIndex(batch.staged[i]->getId());
+            parts[shard].staged.push_back(batch.staged[i]);
+            positions[shard].push_back(i);
+        }
+        vector<unique_lock<recursive_mutex>> locks;
+        for(size_t shard = 0; shard < shards.size(); shard++) {
+            if(parts[shard].size() > 0) locks.emplace_back(shards[shard]->rosterLock);
+        }
+        vector<BatchIssue> issues;
+        // Repeats of an ID share a shard, so each part sees its own duplicates.
+        for(size_t shard = 0; shard < shards.size(); shard++) {
+            if(parts[shard].size() == 0) continue;
+            for(const BatchIssue& issue : shards[shard]->validateBatch(parts[shard])) {
+                issues.push_back({ positions[shard][issue.index], issue.id, issue.reason });
+            }
+        }
+        if(issues.empty()) {
+            // Validated under the locks; with no ID claims to race, this cannot fail.
+            for(size_t shard = 0; shard < shards.size(); shard++) {
+                if(parts[shard].size() > 0) shards[shard]->commitValidated(parts[shard]);
+            }
+            batch.staged.clear();
+        } else {
+            for(PayrollBatch& part : parts) part.staged.clear(); // still owned by batch
+            sort(issues.begin(), issues.end(), [](const BatchIssue& a, const BatchIssue& b) { return a.index < b.index; });
+        }
+        return issues;
+    }
+
+    const Employee* findEmployee(const EmployeeId& id) const {
+        return shardFor(id).findEmployee(id);
+    }
+
+    size_t employeeCount() const {
+        size_t total = 0;
+        for(const auto& shard : shards) total += shard->employeeCount();
+        return total;
+    }
+
+    size_t employeeCount(EmployeeType type) const {
+        size_t total = 0;
+        for(const auto& shard : shards) total += shard->employeeCount(type);
+        return total;
+    }
+
+    // Shard totals merged in shard order, so the result does not depend on
+    // which shard finished first.
+    double totalPayroll() const {
+        CompensatedSum total;
+        for(const auto& shard : shards) total.add(shard->totalPayroll());
+        return total.value();
+    }
+
+    double totalPayroll(EmployeeType type) const {
+        CompensatedSum total;
+        for(const auto& shard : shards) total.add(shard->totalPayroll(type));
+        return total.value();
+    }
+
+    // Merges the shards' ordered runs with a heap. Insertion order is only
+    // known within a shard, so that order lists the shards one after another.
+    void renderSortedReport(string& out, ReportOrder order, size_t limit = 0) const {
+        vector<shared_ptr<const RosterSnapshot>> pins;
+        vector<vector<const Employee*>> runs;
+        for(const auto& shard : shards) {
+            pins.push_back(shard->snapshot());
+            runs.push_back(shard->orderedEmployees(order, limit));
+        }
+
+        auto before = [order](const Employee* a, const Employee* b) {
+            switch(order) {
+                case ReportOrder::SalaryDescending: return a->getSalary() > b->getSalary();
+                case ReportOrder::SalaryAscending: return a->getSalary() < b->getSalary();
+                case ReportOrder::IdAscending: return a->getId() < b->getId();
+                default: return false;
+            }
+        };
+        struct Cursor { size_t run, position; };
+        auto later = [&](const Cursor& a, const Cursor& b) {
+            const Employee* x = runs[a.run][a.position];
+            const Employee* y = runs[b.run][b.position];
+            if(before(x, y)) return false;
+            if(before(y, x)) return true;
+            return a.run > b.run;
+        };
+        vector<Cursor> heap;
+        for(size_t i = 0; i < runs.size(); i++) {
+            if(!runs[i].empty()) heap.push_back({ i, 0 });
+        }
+        make_heap(heap.begin(), heap.end(), later);
+
+        AllocScope scope(AllocCategory::Report);
+        out.clear();
+        if(heap.empty()) {
+            out += "No employees in system!\n\n";
+            return;
+        }
+        out += "\nEmployee Payroll Report ---\n";
+        size_t rendered = 0;
+        while(!heap.empty() && (limit == 0 || rendered < limit)) {
+            pop_heap(heap.begin(), heap.end(), later);
+            Cursor& next = heap.back();
+            runs[next.run][next.position]->render(out);
+            rendered++;
+            if(++next.position < runs[next.run].size()) push_heap(heap.begin(), heap.end(), later);
+            else heap.pop_back();
+        }
+    }
+
+    // Insertion order does not survive sharding; the full report is by ID.
+    void renderPayrollReport(string& out) const {
+        renderSortedReport(out, ReportOrder::IdAscending);
+    }
+};
+
+// Test mode: asserts that lookups, aggregates and report rendering into a
+// reused buffer perform no heap allocations once warmed up.
+int runAllocationCheck() {
+    AllocTracker::startCounting();
+    PayrollSystem payroll;
+    vector<string> ids;
+    payroll.reserve(1000);
+    for(int i = 0; i < 1000; i++) {
+        string id = (i % 100 == 0 ? "CONTRACTOR" : "EMP") + to_string(i);
+        ids.push_back(id);
+        switch(i % 3) {
+            case 0: payroll.emplaceEmployee<FullTimeEmployee>(id, "Full Timer", 4000.0 + i); break;
+            case 1: payroll.emplaceEmployee<PartTimeEmployee>(id, "Part Timer", 15.5, i % 80); break;
+            case 2: payroll.emplaceEmployee<ContractualEmployee>(id, "Contractor", 900.0, i % 7); break;
+        }
+    }
+    ids.push_back("MISSING");
+
+    string report;
+    double checksum = 0.0;
+    auto lookups = [&]() {
+        for(const auto& id : ids) {
+            const Employee* emp = payroll.findEmployee(id);
+            if(emp) checksum += emp->getSalary();
+        }
+    };
+    auto aggregates = [&]() {
+        checksum += payroll.totalPayroll() + payroll.employeeCount();
+    };
+    auto rendering = [&]() {
+        payroll.renderPayrollReport(report);
+        checksum += report.size();
+    };
+
+    struct Check { const char* name; function<void()> run; };
+    vector<Check> checks = {
+        { "ID lookup", lookups },
+        { "Aggregate queries", aggregates },
+        { "Report rendering", rendering }
+    };
+
+    bool passed = true;
+    for(auto& check : checks) {
+        check.run(); // warm-up
+        size_t before = AllocTracker::totalAllocations();
+        check.run();
+        size_t allocations = AllocTracker::totalAllocations() - before;
+        cout << (allocations == 0 ? "PASS " : "FAIL ") << check.name
+             << " (" << allocations << " allocations)\n";
+        if(allocations != 0) passed = false;
+    }
+
+    // Over-aligned types use the align_val_t overloads; they must be counted too.
+    struct alignas(128) CacheBlock { char bytes[128]; };
+    AllocCounters before = AllocTracker::counters(AllocCategory::General);
+    CacheBlock* blocks = new CacheBlock[3];
+    bool aligned = reinterpret_cast<uintptr_t>(blocks) % alignof(CacheBlock) == 0;
+    delete[] blocks;
+    AllocCounters after = AllocTracker::counters(AllocCategory::General);
+    bool tracked = aligned && after.allocations == before.allocations + 1 && after.frees == before.frees + 1;
+    cout << (tracked ? "PASS " : "FAIL ") << "Over-aligned allocation tracking\n";
+    passed = passed && tracked;
+    cout << "Checksum: " << checksum << "\n\n";
+    AllocTracker::printStats();
+    return passed ? 0 : 1;
+}
+
+// Synthetic names drawn from small first/last name lists, like a real roster.
+string syntheticName(uint64_t seed) {
+    static const char* first[] = { "James", "Mary", "John", "Patricia", "Robert", "Jennifer",
+        "Michael", "Linda", "William", "Elizabeth", "David", "Barbara", "Richard", "Susan",
+        "Joseph", "Jessica", "Thomas", "Sarah", "Charles", "Karen", "Maria", "Jose", "Wei", "Aiko" };
+    static const char* last[] = { "Smith", "Johnson", "Williams", "Brown", "Jones", "Garcia",
+        "Miller", "Davis", "Rodriguez", "Martinez", "Hernandez", "Lopez", "Gonzalez", "Wilson",
+        "Anderson", "Thomas", "Taylor", "Moore", "Jackson", "Martin", "Lee", "Perez", "Santos",
+        "Reyes", "Cruz", "Bautista", "Tanaka", "Nguyen", "Kim", "Chen", "Singh", "Meer" };
+    uint64_t h = mixBits(seed);
+    string name = first[h % (sizeof(first) / sizeof(first[0]))];
+    name += ' ';
+    name += last[(h >> 20) % (sizeof(last) / sizeof(last[0]))];
+    return name;
+}
+
+// Fills payroll with count synthetic employees cycling through the three types.
+void populateSynthetic(PayrollSystem& payroll, size_t count) {
+    payroll.reserve(count);
+    string id, name;
+    for(size_t i = 0; i < count; i++) {
+        id = "E";
+        id += to_string(i);
+        name = syntheticName(i);
+        uint64_t h = mixBits(i + 0x9e3779b97f4a7c15ull);
+        switch(i % 3) {
+            case 0: payroll.emplaceEmployee<FullTimeEmployee>(id, name, 2000.0 + h % 8000); break;
+            case 1: payroll.emplaceEmployee<PartTimeEmployee>(id, name, 10.0 + h % 40, int(h % 160)); break;
+            case 2: payroll.emplaceEmployee<ContractualEmployee>(id, name, 500.0 + h % 2500, int(h % 12)); break;
+        }
+    }
+}
+
+double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int benchInterning(size_t count) {
+    PayrollSystem payroll;
+    auto start = chrono::steady_clock::now();
+    populateSynthetic(payroll, count);
+    double seconds = secondsSince(start);
+    cout << "Inserted " << payroll.employeeCount() << " employees with name interning in "
+         << seconds << " s (" << payroll.employeeCount() / seconds << " inserts/s)\n";
+    payroll.displayMemoryStats();
+    return 0;
+}
+
+int benchSorting(size_t count) {
+    PayrollSystem payroll;
+    populateSynthetic(payroll, count);
+    cout << "Roster: " << payroll.employeeCount() << " employees\n";
+
+    struct Case { const char* name; ReportOrder order; size_t limit; };
+    Case cases[] = {
+        { "Sorted by salary (radix)", ReportOrder::SalaryDescending, 0 },
+        { "Sorted by ID (radix)", ReportOrder::IdAscending, 0 },
+        { "Top 100 by salary (heap)", ReportOrder::SalaryDescending, 100 }
+    };
+    for(const auto& c : cases) {
+        auto start = chrono::steady_clock::now();
+        vector<uint32_t> rows = payroll.orderedRows(c.order, c.limit);
+        cout << c.name << ": " << secondsSince(start) * 1000 << " ms (" << rows.size() << " rows)\n";
+    }
+
+    vector<SortEntry> entries = payroll.sortKeys(ReportOrder::SalaryDescending);
+    auto start = chrono::steady_clock::now();
+    sort(entries.begin(), entries.end(), [](const SortEntry& a, const SortEntry& b) { return a.key < b.key; });
+    cout << "Reference std::sort on the same keys: " << secondsSince(start) * 1000 << " ms\n";
+    return 0;
+}
+
+int benchRangeQueries(size_t count) {
+    PayrollSystem payroll;
+    populateSynthetic(payroll, count);
+    const int queries = 1000;
+
+    size_t indexed = 0;
+    auto start = chrono::steady_clock::now();
+    for(int q = 0; q < queries; q++) {
+        double low = 500.0 + mixBits(q) % 9000;
+        indexed += payroll.findBySalaryRange(low, low + 10).size();
+    }
+    double indexSeconds = secondsSince(start);
+
+    size_t counted = 0;
+    start = chrono::steady_clock::now();
+    for(int q = 0; q < queries; q++) {
+        double low = 500.0 + mixBits(q) % 9000;
+        counted += payroll.countBySalaryRange(low, low + 10);
+    }
+    double countSeconds = secondsSince(start);
+
+    cout << "Roster: " << payroll.employeeCount() << " employees, " << queries << " range queries\n";
+    cout << "Indexed range lookups: " << indexSeconds * 1e6 / queries << " us/query ("
+         << indexed << " rows returned)\n";
+    cout << "Indexed range counts: " << countSeconds * 1e6 / queries << " us/query ("
+         << counted << " rows counted)\n";
+    return 0;
+}
+
+int benchTypeBitmaps(size_t count) {
+    // Skewed roster: contractors are rare, so a filtered scan should be cheap.
+    PayrollSystem payroll;
+    payroll.reserve(count);
+    for(size_t i = 0; i < count; i++) {
+        string id = "E" + to_string(i);
+        uint64_t h = mixBits(i);
+        if(h % 1000 < 5) payroll.emplaceEmployee<ContractualEmployee>(id, syntheticName(i), 900.0, int(h % 9));
+        else if(h % 1000 < 100) payroll.emplaceEmployee<PartTimeEmployee>(id, syntheticName(i), 18.0, int(h % 120));
+        else payroll.emplaceEmployee<FullTimeEmployee>(id, syntheticName(i), 3000.0 + h % 5000);
+    }
+    cout << "Roster: " << payroll.employeeCount() << " employees\n";
+
+    for(size_t t = 0; t < static_cast<size_t>(EmployeeType::Count); t++) {
+        EmployeeType type = static_cast<EmployeeType>(t);
+        auto start = chrono::steady_clock::now();
+        double bitmapTotal = payroll.totalPayroll(type);
+        double bitmapSeconds = secondsSince(start);
+
+        start = chrono::steady_clock::now();
+        double scanTotal = 0.0;
+        for(uint32_t row = 0; row < payroll.rowCount(); row++) {
+            const Employee* emp = payroll.employeeAt(row);
+            if(emp && emp->getType() == type) scanTotal += emp->getSalary();
+        }
+        double scanSeconds = secondsSince(start);
+
+        cout << employeeTypeName(type) << ": " << payroll.employeeCount(type) << " rows, bitmap "
+             << bitmapSeconds * 1000 << " ms, full scan " << scanSeconds * 1000 << " ms"
+             << (bitmapTotal == scanTotal ? "" : " (MISMATCH)") << "\n";
+    }
+    return 0;
+}
+
+int benchPrefixSearch(size_t count) {
+    PayrollSystem payroll;
+    populateSynthetic(payroll, count);
+    payroll.findByNamePrefix("a", 1); // first query merges the bulk-loaded entries
+
+    const int queries = 1000;
+    size_t found = 0;
+    auto start = chrono::steady_clock::now();
+    for(int q = 0; q < queries; q++) {
+        string name = syntheticName(mixBits(q));
+        size_t length = 2 + q % 5;
+        found += payroll.findByNamePrefix(string_view(name).substr(0, length), 50).size();
+    }
+    double seconds = secondsSince(start);
+    cout << "Roster: " << payroll.employeeCount() << " employees\n";
+    cout << "Prefix search (first 50 matches): " << seconds * 1e6 / queries << " us/query ("
+         << found << " rows returned)\n";
+    return 0;
+}
+
+int benchFuzzySearch(size_t count) {
+    PayrollSystem payroll;
+    populateSynthetic(payroll, count);
+
+    const int queries = 1000;
+    size_t found = 0;
+    auto start = chrono::steady_clock::now();
+    for(int q = 0; q < queries; q++) {
+        string name = syntheticName(mixBits(q));
+        name[1 + q % (name.size() - 2)] = 'x'; // one typo per query
+        found += payroll.findByFuzzyName(name, 10).size();
+    }
+    double seconds = secondsSince(start);
+    cout << "Roster: " << payroll.employeeCount() << " employees\n";
+    cout << "Fuzzy search (top 10): " << seconds * 1e6 / queries << " us/query ("
+         << found << " rows returned)\n";
+    payroll.displayMemoryStats();
+    return 0;
+}
+
+int benchChurn(size_t count) {
+    PayrollSystem payroll;
+    populateSynthetic(payroll, count);
+
+    // Handles taken up front must follow their employee through updates and
+    // compaction, and go stale once it is removed. Removed IDs are re-added,
+    // so compaction runs while rows keep being appended.
+    vector<pair<string, EmployeeHandle>> tracked;
+    for(size_t i = 0; i < count && tracked.size() < 1000; i += 97) {
+        EmployeeHandle handle;
+        string id = "E" + to_string(i);
+        if(payroll.handleOf(id, handle)) tracked.push_back({ id, handle });
+    }
+
+    auto start = chrono::steady_clock::now();
+    size_t removed = 0, updated = 0, readded = 0;
+    string lastRemoved;
+    for(size_t i = 0; i < count; i++) {
+        uint64_t h = mixBits(i * 7 + 1);
+        string id = "E" + to_string(h % count);
+        if(h % 4 < 2) {
+            if(payroll.removeEmployee(id)) {
+                removed++;
+                lastRemoved = id;
+            }
+        } else if(h % 4 == 2 && !lastRemoved.empty()) {
+            payroll.emplaceEmployee<FullTimeEmployee>(lastRemoved, syntheticName(h), 1000.0 + h % 9000);
+            lastRemoved.clear();
+            readded++;
+        } else {
+            updated += payroll.updateMonthlySalary(id, 1000.0 + h % 9000)
+                     || payroll.updateHoursWorked(id, int(h % 200))
+                     || payroll.updateProjectsCompleted(id, int(h % 15));
+        }
+    }
+    double seconds = secondsSince(start);
+
+    double byType = 0.0;
+    for(size_t t = 0; t < static_cast<size_t>(EmployeeType::Count); t++) {
+        byType += payroll.totalPayroll(static_cast<EmployeeType>(t));
+    }
+    size_t inRange = payroll.countBySalaryRange(0, numeric_limits<double>::max());
+    bool consistent = inRange == payroll.employeeCount() && byType == payroll.totalPayroll();
+    for(const auto& entry : tracked) {
+        // A removed employee's handle stays stale even if the ID is added again.
+        const Employee* resolved = payroll.resolve(entry.second);
+        if(resolved && resolved != payroll.findEmployee(entry.first)) consistent = false;
+    }
+    // The published rows must mirror storage, tombstones included.
+    shared_ptr<const RosterSnapshot> snap = payroll.snapshot();
+    consistent = consistent && snap->rows.size() == payroll.rowCount();
+    for(uint32_t row = 0; consistent && row < snap->rows.size(); row++) {
+        consistent = snap->rows.get(row) == payroll.employeeAt(row);
+    }
+    // Name searches must see exactly the employees still on the roster.
+    size_t expected = 0;
+    for(uint32_t row = 0; row < payroll.rowCount(); row++) {
+        const Employee* emp = payroll.employeeAt(row);
+        if(emp && (emp->getName().compare(0, 3, "Gar") == 0 || emp->getName().find(" Gar") != string::npos)) expected++;
+    }
+    start = chrono::steady_clock::now();
+    size_t found = payroll.findByNamePrefix("gar").size();
+    double querySeconds = secondsSince(start);
+    consistent = consistent && found == expected;
+    for(const auto& result : payroll.findByFuzzyName("Garsia", 50)) {
+        consistent = consistent && result.employee && result.employee->getName().find("Garcia") != string::npos;
+    }
+
+    cout << "Roster: " << count << " employees, " << removed << " removed, " << readded << " re-added, " << updated
+         << " updated in " << seconds << " s (" << count / seconds << " ops/s)\n";
+    cout << "Prefix query after churn: " << found << " matches in " << querySeconds * 1000 << " ms\n";
+    cout << "Indexes " << (consistent ? "consistent" : "INCONSISTENT") << "\n";
+    payroll.displayMemoryStats();
+    return consistent ? 0 : 1;
+}
+
+// Readers work on snapshots while writers insert, update and remove; every
+// reader checks that what it sees is internally consistent.
+int benchSnapshots(size_t count) {
+    PayrollSystem payroll;
+    populateSynthetic(payroll, count);
+    const int lookupThreads = 3, writerThreads = 2;
+    const double phaseSeconds = 1.0;
+
+    vector<EmployeeId> sample;
+    for(size_t i = 0; i < 4096; i++) sample.push_back(EmployeeId::fromString("E" + to_string(mixBits(i) % count)));
+
+    atomic<bool> stop(false), failed(false);
+    atomic<size_t> lookups(0), reports(0), writes(0);
+
+    auto lookupReader = [&](size_t seed) {
+        uint64_t lastVersion = 0;
+        size_t done = 0;
+        for(size_t i = seed; !stop; i++) {
+            shared_ptr<const RosterSnapshot> snap = payroll.snapshot();
+            if(snap->version < lastVersion) failed = true;
+            lastVersion = snap->version;
+            size_t typed = 0;
+            for(size_t t = 0; t < static_cast<size_t>(EmployeeType::Count); t++) {
+                typed += snap->employeeCount(static_cast<EmployeeType>(t));
+            }
+            if(typed != snap->employeeCount()) failed = true;
+            for(size_t k = 0; k < 16; k++) {
+                const EmployeeId& id = sample[(i * 16 + k) & (sample.size() - 1)];
+                const Employee* emp = snap->find(id);
+                if(emp && (emp->getId() != id || emp->getSalary() < 0)) failed = true;
+            }
+            done += 16;
+        }
+        lookups += done;
+    };
+
+    auto reportReader = [&]() {
+        string report;
+        size_t done = 0;
+        while(!stop) {
+            shared_ptr<const RosterSnapshot> snap = payroll.snapshot();
+            snap->renderPayrollReport(report);
+            size_t live = 0;
+            snap->rows.forEach([&](const Employee* emp) { live += emp != nullptr; });
+            if(live != snap->employeeCount()) failed = true;
+            done++;
+        }
+        reports += done;
+    };
+
+    auto writer = [&](int w) {
+        size_t done = 0;
+        string id;
+        for(uint64_t i = 0; !stop; i++) {
+            uint64_t h = mixBits(i * writerThreads + w);
+            id = "W" + to_string(w) + "x" + to_string(i);
+            payroll.emplaceEmployee<FullTimeEmployee>(id, syntheticName(h), 2500.0 + h % 5000);
+            id = "E" + to_string(h % count);
+            if(h % 4 == 0) {
+                payroll.removeEmployee(id);
+            } else {
+                payroll.updateMonthlySalary(id, 1000.0 + h % 9000)
+                    || payroll.updateHoursWorked(id, int(h % 200))
+                    || payroll.updateProjectsCompleted(id, int(h % 15));
+            }
+            done += 2;
+        }
+        writes += done;
+    };
+
+    cout << "Roster: " << count << " employees, " << lookupThreads << " lookup readers, 1 report reader\n";
+    for(int withWriters = 0; withWriters < 2; withWriters++) {
+        stop = false;
+        lookups = reports = writes = 0;
+        vector<thread> threads;
+        for(int r = 0; r < lookupThreads; r++) threads.emplace_back(lookupReader, r * 7919);
+        threads.emplace_back(reportReader);
+        if(withWriters) {
+            for(int w = 0; w < writerThreads; w++) threads.emplace_back(writer, w);
+        }
+        auto start = chrono::steady_clock::now();
+        this_thread::sleep_for(chrono::duration<double>(phaseSeconds));
+        stop = true;
+        for(auto& t : threads) t.join();
+        double seconds = secondsSince(start);
+        cout << (withWriters ? "With " : "Without ") << "writers: "
+             << lookups / seconds << " lookups/s, " << reports / seconds << " reports/s";
+        if(withWriters) cout << ", " << writes / seconds << " writes/s (" << writerThreads << " writers)";
+        cout << "\n";
+    }
+    cout << "Snapshots " << (failed ? "INCONSISTENT" : "consistent") << " (" << payroll.employeeCount()
+         << " employees at version " << payroll.snapshot()->version << ")\n";
+    return failed ? 1 : 0;
+}
+
+// Parallel bulk load into one locked roster versus a sharded one.
+int benchShardedInserts(size_t count) {
+    const size_t shardCount = 16;
+    const size_t batchSize = 1000; // one publication per batch (per shard when sharded)
+    auto load = [count, batchSize](size_t threadCount, auto& payroll) {
+        vector<thread> threads;
+        for(size_t t = 0; t < threadCount; t++) {
+            threads.emplace_back([&payroll, t, threadCount, count, batchSize]() {
+                string id, name;
+                PayrollBatch batch;
+                for(size_t i = t; i < count; i += threadCount) {
+                    id = "E";
+                    id += to_string(i);
+                    name = syntheticName(i);
+                    uint64_t h = mixBits(i);
+                    switch(i % 3) {
+                        case 0: batch.stage<FullTimeEmployee>(id, name, 2000.0 + h % 8000); break;
+                        case 1: batch.stage<PartTimeEmployee>(id, name, 10.0 + h % 40, int(h % 160)); break;
+                        case 2: batch.stage<ContractualEmployee>(id, name, 500.0 + h % 2500, int(h % 12)); break;
+                    }
+                    if(batch.size() == batchSize) payroll.commitBatch(batch);
+                }
+                payroll.commitBatch(batch);
+            });
+        }
+        for(auto& thread : threads) thread.join();
+    };
+
+    size_t hardware = max<size_t>(1, thread::hardware_concurrency());
+    cout << "Inserting " << count << " employees in batches of " << batchSize << " (" << hardware << " hardware threads)\n";
+    if(hardware < 4) cout << "Too few hardware threads to show scaling; runs with more threads measure contention overhead only\n";
+    bool complete = true;
+    for(size_t threadCount = 1; threadCount <= 64; threadCount *= 2) {
+        double single, sharded;
+        {
+            PayrollSystem payroll;
+            payroll.reserve(count);
+            auto start = chrono::steady_clock::now();
+            load(threadCount, payroll);
+            single = secondsSince(start);
+            if(payroll.employeeCount() != count) complete = false;
+        }
+        {
+            ShardedPayrollSystem payroll(shardCount);
+            payroll.reserve(count);
+            auto start = chrono::steady_clock::now();
+            load(threadCount, payroll);
+            sharded = secondsSince(start);
+            if(payroll.employeeCount() != count) complete = false;
+        }
+        cout << threadCount << " thread(s): single lock " << count / single << " inserts/s, "
+             << shardCount << " shards " << count / sharded << " inserts/s\n";
+    }
+    cout << (complete ? "All inserts accounted for\n" : "MISSING INSERTS\n");
+
+    // A batch with a bad record in one shard must leave every shard untouched.
+    ShardedPayrollSystem payroll(shardCount);
+    PayrollBatch batch;
+    for(size_t i = 0; i < 100; i++) batch.stage<FullTimeEmployee>("E" + to_string(i), syntheticName(i), 1000.0 + i);
+    batch.stage<FullTimeEmployee>(EmployeeId("E42"), "Repeated Id", 1000.0);
+    vector<BatchIssue> issues = payroll.commitBatch(batch);
+    bool rejected = issues.size() == 1 && issues[0].index == 100 && payroll.employeeCount() == 0 && batch.size() == 101;
+    batch.clear();
+    for(size_t i = 0; i < 100; i++) batch.stage<FullTimeEmployee>("E" + to_string(i), syntheticName(i), 1000.0 + i);
+    rejected = rejected && payroll.commitBatch(batch).empty() && payroll.employeeCount() == 100 && batch.size() == 0
+            && payroll.totalPayroll() == 100 * 1000.0 + 99 * 100 / 2;
+    cout << (rejected ? "Invalid sharded batch rejected, valid one committed\n" : "SHARDED BATCH MISHANDLED\n");
+    return complete && rejected ? 0 : 1;
+}
+
+// Many threads claiming IDs from a small key space, so most claims collide.
+int benchIdClaims(size_t count) {
+    vector<EmployeeId> keys(count);
+    for(size_t i = 0; i < count; i++) keys[i] = EmployeeId::fromString("E" + to_string(i));
+
+    auto run = [&](size_t threadCount, size_t keySpace, auto claim) {
+        atomic<size_t> claimed(0);
+        vector<thread> threads;
+        auto start = chrono::steady_clock::now();
+        for(size_t t = 0; t < threadCount; t++) {
+            threads.emplace_back([&, t]() {
+                size_t mine = 0;
+                for(size_t i = t; i < count; i += threadCount) mine += claim(keys[mixBits(i) % keySpace]);
+                claimed += mine;
+            });
+        }
+        for(auto& thread : threads) thread.join();
+        return make_pair(secondsSince(start), claimed.load());
+    };
+
+    bool consistent = true;
+    cout << count << " claims per run\n";
+    for(int duplicatePercent : { 0, 50, 90, 99 }) {
+        size_t keySpace = max<size_t>(1, count * (100 - duplicatePercent) / 100);
+        for(size_t threadCount : { 1, 4, 16, 64 }) {
+            ConcurrentIdSet set;
+            auto lockFree = run(threadCount, keySpace, [&](const EmployeeId& id) { return set.insert(id); });
+
+            mutex lock;
+            unordered_set<EmployeeId, EmployeeIdHash> locked;
+            auto baseline = run(threadCount, keySpace, [&](const EmployeeId& id) {
+                lock_guard<mutex> guard(lock);
+                return locked.insert(id).second;
+            });
+
+            if(lockFree.second != set.size() || lockFree.second != baseline.second) consistent = false;
+            cout << duplicatePercent << "% duplicates, " << threadCount << " thread(s): lock-free "
+                 << count / lockFree.first << " claims/s (" << set.resizeCount() << " resizes), mutex "
+                 << count / baseline.first << " claims/s, " << lockFree.second << " unique\n";
+        }
+    }
+
+    // Duplicate-heavy ingest into the roster itself.
+    for(bool concurrentIngest : { false, true }) {
+        PayrollSystem payroll(concurrentIngest);
+        auto result = run(8, count / 10, [&](const EmployeeId& id) {
+            return payroll.emplaceEmployee<FullTimeEmployee>(id, "Feed Record", 3000.0) != nullptr;
+        });
+        if(result.second != payroll.employeeCount()) consistent = false;
+        cout << "Roster ingest, 90% duplicates, 8 threads, " << (concurrentIngest ? "lock-free claims: " : "roster lock only: ")
+             << count / result.first << " records/s (" << result.second << " accepted)\n";
+    }
+    cout << (consistent ? "Claims consistent\n" : "CLAIMS INCONSISTENT\n");
+    return consistent ? 0 : 1;
+}
+
+// Serial versus scheduled bulk operations on the same roster.
+int benchScheduler(size_t count) {
+    PayrollSystem payroll;
+    populateSynthetic(payroll, count);
+    cout << "Roster: " << payroll.employeeCount() << " employees\n";
+
+    double serialTotal = 0.0;
+    string serialReport, report;
+    bool identical = true;
+    for(size_t workers : { 0, 1, 2, 4, 8 }) {
+        unique_ptr<TaskScheduler> scheduler;
+        if(workers > 0) scheduler = make_unique<TaskScheduler>(workers);
+        payroll.useScheduler(scheduler.get());
+
+        auto start = chrono::steady_clock::now();
+        double total = payroll.totalPayroll();
+        double totalSeconds = secondsSince(start);
+
+        start = chrono::steady_clock::now();
+        payroll.renderPayrollReport(report);
+        double reportSeconds = secondsSince(start);
+
+        start = chrono::steady_clock::now();
+        vector<SortEntry> keys = payroll.sortKeys(ReportOrder::SalaryDescending);
+        double keySeconds = secondsSince(start);
+
+        if(workers == 0) {
+            serialTotal = total;
+            serialReport = report;
+            cout << "Serial";
+        } else {
+            if(total != serialTotal || report != serialReport || keys.size() != payroll.employeeCount()) identical = false;
+            cout << workers << " worker(s)";
+        }
+        cout << ": total " << totalSeconds * 1000 << " ms, report " << reportSeconds * 1000
+             << " ms, sort keys " << keySeconds * 1000 << " ms\n";
+        if(workers == 8) scheduler->displayStats();
+        payroll.useScheduler(nullptr);
+    }
+    cout << (identical ? "Scheduled results match serial\n" : "SCHEDULED RESULTS DIFFER\n");
+    return identical ? 0 : 1;
+}
+
+// Totals over fractional salaries must come out bit-identical for every
+// worker count; a plain running sum is shown for comparison.
+int benchDeterministicTotals(size_t count) {
+    PayrollSystem payroll;
+    payroll.reserve(count);
+    for(size_t i = 0; i < count; i++) {
+        uint64_t h = mixBits(i);
+        string id = "E" + to_string(i);
+        switch(i % 3) {
+            case 0: payroll.emplaceEmployee<FullTimeEmployee>(id, syntheticName(i), 1000.0 + (h % 900000) / 100.0); break;
+            case 1: payroll.emplaceEmployee<PartTimeEmployee>(id, syntheticName(i), 7.25 + (h % 5000) / 100.0, int(h % 160)); break;
+            case 2: payroll.emplaceEmployee<ContractualEmployee>(id, syntheticName(i), 0.1 * (h % 30000), int(h % 12)); break;
+        }
+    }
+    double naive = 0.0;
+    for(uint32_t row = 0; row < payroll.rowCount(); row++) naive += payroll.employeeAt(row)->getSalary();
+
+    auto bits = [](double value) {
+        uint64_t raw;
+        memcpy(&raw, &value, sizeof(raw));
+        return raw;
+    };
+    cout.precision(17);
+    cout << "Roster: " << payroll.employeeCount() << " employees\n";
+    cout << "Plain running sum: " << naive << "\n";
+
+    bool reproducible = true;
+    uint64_t reference[1 + static_cast<size_t>(EmployeeType::Count)] = {};
+    for(size_t workers : { 0, 1, 2, 3, 4, 8 }) {
+        unique_ptr<TaskScheduler> scheduler;
+        if(workers > 0) scheduler = make_unique<TaskScheduler>(workers);
+        payroll.useScheduler(scheduler.get());
+
+        auto start = chrono::steady_clock::now();
+        double total = payroll.totalPayroll();
+        double totalSeconds = secondsSince(start);
+        start = chrono::steady_clock::now();
+        PayrollTotals totals = payroll.payrollTotals();
+        double totalsSeconds = secondsSince(start);
+        double byType[static_cast<size_t>(EmployeeType::Count)];
+        for(size_t t = 0; t < static_cast<size_t>(EmployeeType::Count); t++) {
+            byType[t] = payroll.totalPayroll(static_cast<EmployeeType>(t));
+        }
+
+        uint64_t observed[] = { bits(total), bits(byType[0]), bits(byType[1]), bits(byType[2]) };
+        if(workers == 0) memcpy(reference, observed, sizeof(reference));
+        else if(memcmp(reference, observed, sizeof(reference)) != 0) reproducible = false;
+        if(bits(totals.total.value()) != bits(total)) reproducible = false;
+
+        cout << (workers == 0 ? string("Serial") : to_string(workers) + " worker(s)") << ": total " << total
+             << " in " << long(totalSeconds * 1e6) << " us, all totals " << long(totalsSeconds * 1e6) << " us, by type "
+             << byType[0] << " / " << byType[1] << " / " << byType[2] << "\n";
+        payroll.useScheduler(nullptr);
+    }
+    cout.precision(6);
+    cout << (reproducible ? "Totals bit-identical across worker counts\n" : "TOTALS DIFFER ACROSS WORKER COUNTS\n");
+    return reproducible ? 0 : 1;
+}
+
+// Importing in all-or-nothing batches versus one add per record.
+int benchBatchCommits(size_t count) {
+    auto stageRecord = [](PayrollBatch& batch, size_t i) {
+        string id = "E" + to_string(i);
+        uint64_t h = mixBits(i);
+        switch(i % 3) {
+            case 0: batch.stage<FullTimeEmployee>(id, syntheticName(i), 2000.0 + h % 8000); break;
+            case 1: batch.stage<PartTimeEmployee>(id, syntheticName(i), 10.0 + h % 40, int(h % 160)); break;
+            case 2: batch.stage<ContractualEmployee>(id, syntheticName(i), 500.0 + h % 2500, int(h % 12)); break;
+        }
+    };
+
+    {
+        PayrollSystem payroll;
+        auto start = chrono::steady_clock::now();
+        populateSynthetic(payroll, count);
+        double seconds = secondsSince(start);
+        cout << "Individual adds: " << count / seconds << " employees/s\n";
+    }
+    for(size_t batchSize : { size_t(100), size_t(10000), count }) {
+        PayrollSystem payroll;
+        PayrollBatch batch;
+        double seconds = 0.0;
+        for(size_t begin = 0; begin < count; begin += batchSize) {
+            for(size_t i = begin; i < min(count, begin + batchSize); i++) stageRecord(batch, i);
+            auto start = chrono::steady_clock::now(); // staging builds the records, as the loop above does
+            payroll.commitBatch(batch);
+            seconds += secondsSince(start);
+        }
+        cout << "Batches of " << batchSize << ": " << count / seconds << " employees/s committed ("
+             << payroll.employeeCount() << " employees)\n";
+    }
+
+    // Failed batches must leave the roster untouched.
+    PayrollSystem payroll;
+    populateSynthetic(payroll, 1000);
+    uint64_t version = payroll.snapshot()->version;
+    PayrollBatch bad;
+    for(size_t i = 5000; i < 6000; i++) stageRecord(bad, i);
+    stageRecord(bad, 5500); // repeated within the batch
+    stageRecord(bad, 7);    // already on the roster
+    bad.stage<FullTimeEmployee>(EmployeeId("NEG1"), "Negative Pay", -10.0);
+    vector<BatchIssue> issues = payroll.commitBatch(bad);
+    bool untouched = payroll.employeeCount() == 1000 && payroll.snapshot()->version == version
+                  && !payroll.findEmployee(string("E5000")) && bad.size() == 1003;
+    for(const auto& issue : issues) {
+        cout << "Rejected record " << issue.index << " (" << issue.id.str() << "): " << issue.reason << "\n";
+    }
+    bool rejected = issues.size() == 3 && untouched;
+    cout << (rejected ? "Invalid batch rejected, roster unchanged\n" : "INVALID BATCH NOT REJECTED CLEANLY\n");
+    return rejected ? 0 : 1;
+}
+
+// Random edits are undone and redone step by step; checkpoints must come
+// back with the exact count and total seen there, and undoing everything
+// must restore the original roster.
+int benchUndoRedo(size_t count) {
+    const size_t steps = 4096;
+    bool consistent = true;
+    for(size_t size : { max<size_t>(count / 16, 1), count }) {
+        PayrollSystem payroll;
+        populateSynthetic(payroll, size);
+        payroll.keepHistory(steps);
+        string original, restored;
+        payroll.renderSortedReport(original, ReportOrder::IdAscending);
+
+        const size_t checkEvery = 64;
+        vector<pair<size_t, double>> states; // at every checkEvery-th step
+        auto state = [&payroll]() { return make_pair(payroll.employeeCount(), payroll.totalPayroll()); };
+        for(size_t i = 0; payroll.undoDepth() < steps; i++) {
+            size_t depth = payroll.undoDepth();
+            if(depth % checkEvery == 0 && states.size() == depth / checkEvery) states.push_back(state());
+            uint64_t h = mixBits(i * 31 + 7);
+            string id = "E" + to_string(h % size);
+            switch(h % 4) {
+                case 0: payroll.removeEmployee(id) || payroll.emplaceEmployee<FullTimeEmployee>(id, syntheticName(h), 3000.0); break;
+                case 1: payroll.emplaceEmployee<PartTimeEmployee>("U" + to_string(i), syntheticName(h), 20.0, int(h % 160)); break;
+                default:
+                    payroll.updateMonthlySalary(id, 1000.0 + h % 9000)
+                        || payroll.updateHoursWorked(id, int(h % 200))
+                        || payroll.updateProjectsCompleted(id, int(h % 15));
+                    break;
+            }
+        }
+        states.push_back(state());
+
+        // Only the undo and redo calls are timed, not the checks.
+        double undoSeconds = 0.0, redoSeconds = 0.0;
+        for(size_t i = steps; i-- > 0; ) {
+            auto start = chrono::steady_clock::now();
+            payroll.undo();
+            undoSeconds += secondsSince(start);
+            if(i % checkEvery == 0 && state() != states[i / checkEvery]) consistent = false;
+        }
+        payroll.renderSortedReport(restored, ReportOrder::IdAscending);
+        if(restored != original || payroll.undo()) consistent = false;
+
+        for(size_t i = 1; i <= steps; i++) {
+            auto start = chrono::steady_clock::now();
+            payroll.redo();
+            redoSeconds += secondsSince(start);
+            if(i % checkEvery == 0 && state() != states[i / checkEvery]) consistent = false;
+        }
+        if(payroll.redo()) consistent = false;
+
+        // A new change after an undo discards the redo steps.
+        payroll.undo();
+        payroll.emplaceEmployee<FullTimeEmployee>(string("NEW1"), "New Hire", 4000.0);
+        if(payroll.redoDepth() != 0 || payroll.undoDepth() != steps) consistent = false;
+
+        cout << "Roster " << size << ": undo " << int64_t(undoSeconds / steps * 1e9) << " ns/step, redo "
+             << int64_t(redoSeconds / steps * 1e9) << " ns/step\n";
+        payroll.displayMemoryStats();
+    }
+    cout << "History " << (consistent ? "consistent" : "INCONSISTENT") << "\n";
+    return consistent ? 0 : 1;
+}
+
+// Hundreds of raise scenarios against one roster: forks of the shared pay
+// columns versus copying every employee to try each one.
+int benchScenarios(size_t count) {
+    const size_t scenarioCount = 300;
+    PayrollSystem payroll;
+    populateSynthetic(payroll, count);
+    TaskScheduler scheduler(0);
+    payroll.useScheduler(&scheduler);
+    using Column = PayrollScenario::Column;
+
+    // Reference: clone the roster, apply the raise, sum, free.
+    auto copyAndRaise = [&payroll](double partTime, double contractual) {
+        shared_ptr<const RosterSnapshot> snap = payroll.snapshot();
+        vector<Employee*> copies;
+        copies.reserve(snap->employeeCount());
+        snap->rows.forEach([&](const Employee* emp) { if(emp) copies.push_back(emp->clone()); });
+        CompensatedSum total;
+        for(Employee* emp : copies) {
+            if(auto* p = dynamic_cast<PartTimeEmployee*>(emp)) p->setHourlyRate(p->getHourlyRate() * partTime);
+            if(auto* c = dynamic_cast<ContractualEmployee*>(emp)) c->setPaymentPerProject(c->getPaymentPerProject() * contractual);
+            total.add(emp->getSalary());
+            delete emp;
+        }
+        return total.value();
+    };
+    const size_t copies = 3;
+    auto start = chrono::steady_clock::now();
+    double expected = 0.0;
+    for(size_t i = 0; i < copies; i++) expected = copyAndRaise(1.08, 1.03);
+    double copySeconds = secondsSince(start) / copies;
+
+    start = chrono::steady_clock::now();
+    PayrollScenario baseline = payroll.scenario();
+    double buildSeconds = secondsSince(start);
+    double baseTotal = baseline.totals().total.value();
+
+    start = chrono::steady_clock::now();
+    double best = numeric_limits<double>::max(), checksum = 0.0;
+    for(size_t i = 0; i < scenarioCount; i++) {
+        PayrollScenario fork = baseline;
+        fork.scale(EmployeeType::PartTime, Column::Rate, 1.0 + (i % 20) / 100.0);
+        fork.scale(EmployeeType::Contractual, Column::Rate, 1.0 + (i / 20) / 100.0);
+        fork.clamp(EmployeeType::PartTime, Column::Quantity, 0.0, 120.0); // overtime cap
+        double total = fork.totals(&scheduler).total.value();
+        best = min(best, total);
+        checksum += total;
+    }
+    double forkSeconds = secondsSince(start);
+
+    // The fork must match the copied roster, leave its parent and unrelated
+    // chunks alone, and give the same bits on any number of workers.
+    PayrollScenario raise = payroll.scenario();
+    raise.scale(EmployeeType::PartTime, Column::Rate, 1.08);
+    raise.scale(EmployeeType::Contractual, Column::Rate, 1.03);
+    PayrollTotals serial = raise.totals(), parallel = raise.totals(&scheduler);
+    bool correct = fabs(serial.total.value() - expected) <= 1e-9 * expected
+                && serial.total.value() == parallel.total.value()
+                && baseline.totals().total.value() == baseTotal
+                && payroll.scenario().totals().total.value() == baseTotal;
+    PayrollScenario child = raise;
+    child.set(EmployeeId::fromString("E1"), Column::Quantity, 0.0); // E1 is part-time
+    size_t rateChunks = (count / 3 + PayrollScenario::chunkRows - 1) / PayrollScenario::chunkRows;
+    correct = correct && child.ownedChunks() == 1 && raise.ownedChunks() == 2 * rateChunks
+           && child.totals().total.value() < serial.total.value()
+           && raise.totals().total.value() == serial.total.value();
+
+    cout << "Roster: " << payroll.employeeCount() << " employees, " << baseline.chunkCount() << " column chunks\n";
+    cout << "Copying the roster: " << long(copySeconds * 1e3) << " ms per scenario\n";
+    cout << "Building pay columns: " << long(buildSeconds * 1e3) << " ms (once per version)\n";
+    cout << scenarioCount << " forked scenarios: " << long(forkSeconds * 1e3) << " ms ("
+         << long(forkSeconds / scenarioCount * 1e6) << " us per scenario), cheapest $" << long(best)
+         << " against $" << long(baseTotal) << " today (checksum " << long(checksum) << ")\n";
+    cout << (correct ? "Scenarios match copied rosters and stay isolated\n" : "SCENARIO RESULTS WRONG\n");
+    return correct ? 0 : 1;
+}
+
+// Monte Carlo throughput, and the checks that make it trustworthy: the same
+// bands for any worker count, and a mean close to today's cost per period.
+int benchProjection(size_t count) {
+    PayrollSystem payroll;
+    populateSynthetic(payroll, count);
+    PayrollScenario today = payroll.scenario();
+    ProjectionModel model;
+    model.trials = 500;
+
+    auto start = chrono::steady_clock::now();
+    ProjectionResult serial = projectPayroll(today, model);
+    double serialSeconds = secondsSince(start);
+    TaskScheduler scheduler(0);
+    start = chrono::steady_clock::now();
+    ProjectionResult parallel = projectPayroll(today, model, &scheduler);
+    double parallelSeconds = secondsSince(start);
+
+    double expected = today.totals().total.value() * model.periods;
+    bool consistent = memcmp(serial.percentiles, parallel.percentiles, sizeof(serial.percentiles)) == 0
+                   && serial.mean == parallel.mean && fabs(serial.mean - expected) < 0.005 * expected;
+    for(size_t i = 1; i < 5; i++) consistent = consistent && serial.percentiles[i - 1] <= serial.percentiles[i];
+
+    cout << "Roster: " << payroll.employeeCount() << " employees, " << model.trials << " trials of "
+         << model.periods << " periods\n";
+    cout << "Serial: " << serial.employeePeriods / serialSeconds / 1e6 << " M employee-periods/s\n";
+    cout << scheduler.workerCount() << " worker(s): " << parallel.employeePeriods / parallelSeconds / 1e6
+         << " M employee-periods/s\n";
+    cout << "Annual cost: mean $" << long(serial.mean) << " (today x " << model.periods << " = $" << long(expected) << ")";
+    for(size_t i = 0; i < 5; i++) cout << ", P" << ProjectionResult::levels[i] << " $" << long(serial.percentiles[i]);
+    cout << "\n" << (consistent ? "Projection reproducible and unbiased\n" : "PROJECTION INCONSISTENT\n");
+    return consistent ? 0 : 1;
+}
+
+// Ten years of monthly pay runs with raises, leavers and hires between
+// them; per-period totals from the history must match what each run paid.
+int benchPayRuns(size_t count) {
+    const uint32_t periods = 120;
+    PayrollSystem payroll;
+    populateSynthetic(payroll, count);
+    TaskScheduler scheduler(0);
+    payroll.useScheduler(&scheduler);
+
+    vector<int64_t> expected(periods);
+    vector<EmployeeId> tracked;
+    for(size_t i = 0; i < 16; i++) tracked.push_back(EmployeeId::fromString("E" + to_string(i * 7)));
+    vector<int64_t> trackedPaid(tracked.size());
+    double runSeconds = 0.0;
+    size_t hires = 0;
+    for(uint32_t period = 0; period < periods; period++) {
+        shared_ptr<const RosterSnapshot> snap = payroll.snapshot();
+        snap->rows.forEach([&](const Employee* emp) { if(emp) expected[period] += PayHistory::toCents(emp->getSalary()); });
+        for(size_t i = 0; i < tracked.size(); i++) {
+            if(const Employee* emp = snap->find(tracked[i])) trackedPaid[i] += PayHistory::toCents(emp->getSalary());
+        }
+        snap.reset();
+        auto start = chrono::steady_clock::now();
+        payroll.runPayroll();
+        runSeconds += secondsSince(start);
+
+        for(size_t i = 0; i < count / 50; i++) {
+            uint64_t h = mixBits(uint64_t(period) << 32 | i);
+            string id = "E" + to_string(h % count);
+            if(h % 8 == 0) {
+                payroll.removeEmployee(id);
+                payroll.emplaceEmployee<FullTimeEmployee>("H" + to_string(hires++), syntheticName(h), 2500.0 + h % 5000);
+            } else {
+                payroll.updateMonthlySalary(id, 1000.0 + h % 9000)
+                    || payroll.updateHoursWorked(id, int(h % 200))
+                    || payroll.updateProjectsCompleted(id, int(h % 15));
+            }
+        }
+    }
+
+    auto start = chrono::steady_clock::now();
+    const int queries = 20;
+    vector<int64_t> totals;
+    for(int q = 0; q < queries; q++) totals = payroll.totalsByPeriod(0, periods);
+    double querySeconds = secondsSince(start) / queries;
+
+    bool exact = totals == expected && !payroll.runPayroll(periods - 1);
+    for(size_t i = 0; i < tracked.size(); i++) exact = exact && payroll.paidTo(tracked[i], 0, periods) == trackedPaid[i];
+    for(uint32_t period = 0; period < periods; period += 17) {
+        exact = exact && payroll.totalsByPeriod(period, period + 1) == vector<int64_t>{ expected[period] };
+    }
+
+    cout << "Roster: " << count << " employees, " << periods << " periods, " << count / 50 << " changes per period\n";
+    cout << "Pay runs: " << long(runSeconds / periods * 1e6) << " us per period\n";
+    cout << "Totals per period over all history: " << long(querySeconds * 1e6) << " us\n";
+    payroll.displayMemoryStats();
+    cout << (exact ? "History matches every pay run\n" : "HISTORY MISMATCH\n");
+    return exact ? 0 : 1;
+}
+
+// Writes a synthetic clock-in/clock-out log for the roster built by
+// populateSynthetic and returns the matched seconds per employee index.
+vector<int64_t> writeTimesheetLog(const string& path, size_t employees, size_t events) {
+    vector<int64_t> expected(employees);
+    FILE* file = fopen(path.c_str(), "wb");
+    if(!file) return {};
+    string out;
+    size_t written = 0;
+    const int64_t epoch = 1700000000;
+    for(int64_t day = 0; written < events; day++) {
+        // Everyone clocks in, then everyone clocks out in a different order.
+        for(int pass = 0; pass < 2 && written < events; pass++) {
+            for(size_t k = 0; k < employees && written < events; k++) {
+                size_t i = (k * (pass ? 7919 : 104729)) % employees;
+                uint64_t h = mixBits(uint64_t(day) << 32 | i);
+                int64_t start = epoch + day * 86400 + 8 * 3600 + int64_t(h % 3600);
+                int64_t length = 4 * 3600 + int64_t((h >> 16) % (5 * 3600));
+                out += 'E'; out += to_string(i);
+                out += pass ? ",OUT," : ",IN,";
+                out += to_string(pass ? start + length : start);
+                out += '\n';
+                if(pass) expected[i] += length;
+                written++;
+            }
+            out += "X99999999,OUT,1700000000\nnot an event\n"; // unknown ID and a malformed line
+            if(out.size() > (1 << 20)) {
+                fwrite(out.data(), 1, out.size(), file);
+                out.clear();
+            }
+        }
+    }
+    fwrite(out.data(), 1, out.size(), file);
+    fclose(file);
+    return expected;
+}
+
+int benchTimesheets(size_t events) {
+    // About ten shifts each, for up to 100000 employees.
+    const size_t employees = max<size_t>(1, min<size_t>(100000, events / 20));
+    // One more part-time employee only clocks in; their hours must stay put.
+    const size_t idle = employees + (4 - employees % 3) % 3;
+    string path = "/tmp/payroll_timesheet_bench.csv";
+    vector<int64_t> expected = writeTimesheetLog(path, employees, events);
+    FILE* file = expected.empty() ? nullptr : fopen(path.c_str(), "ab");
+    if(!file) {
+        cout << "Cannot write " << path << "\n";
+        return 1;
+    }
+    fprintf(file, "E%zu,IN,1700000000\n", idle);
+    fclose(file);
+
+    PayrollSystem payroll;
+    populateSynthetic(payroll, idle + 1);
+    const auto* idleEmployee = static_cast<const PartTimeEmployee*>(payroll.findEmployee("E" + to_string(idle)));
+    int idleHours = idleEmployee->getHoursWorked();
+    TaskScheduler scheduler(0);
+
+    TimesheetAggregator serial;
+    auto start = chrono::steady_clock::now();
+    serial.consumeFile(path);
+    double serialSeconds = secondsSince(start);
+    TimesheetAggregator parallel(&scheduler);
+    start = chrono::steady_clock::now();
+    parallel.consumeFile(path);
+    double parallelSeconds = secondsSince(start);
+    start = chrono::steady_clock::now();
+    TimesheetAggregator::Summary summary = payroll.applyTimesheet(parallel);
+    double applySeconds = secondsSince(start);
+    remove(path.c_str());
+
+    bool correct = true;
+    vector<pair<uint64_t, int64_t>> serialSeen, parallelSeen;
+    serial.forEachEmployee([&](const EmployeeId& id, int64_t seconds, bool) { serialSeen.push_back({ id.raw(), seconds }); });
+    parallel.forEachEmployee([&](const EmployeeId& id, int64_t seconds, bool) { parallelSeen.push_back({ id.raw(), seconds }); });
+    correct = serialSeen == parallelSeen;
+    size_t partTime = 0;
+    for(size_t i = 1; i < employees; i += 3) {
+        const auto* emp = static_cast<const PartTimeEmployee*>(payroll.findEmployee("E" + to_string(i)));
+        if(expected[i] == 0) continue;
+        partTime++;
+        if(!emp || emp->getHoursWorked() != int((expected[i] + 1800) / 3600)) correct = false;
+    }
+    correct = correct && summary.updated <= partTime && summary.notPartTime == employees - (employees + 1) / 3
+           && summary.notOnRoster == 1 && summary.malformed > 0 && summary.openSessions == 1
+           && static_cast<const PartTimeEmployee*>(payroll.findEmployee("E" + to_string(idle)))->getHoursWorked() == idleHours;
+
+    double megabytes = summary.bytes / 1e6;
+    cout << "Log: " << summary.events << " events, " << long(megabytes) << " MB, " << summary.employees << " IDs ("
+         << summary.malformed << " malformed, " << summary.unmatched << " unmatched, " << summary.openSessions
+         << " still clocked in)\n";
+    cout << "Serial aggregation: " << long(summary.events / serialSeconds) << " events/s (" << long(megabytes / serialSeconds)
+         << " MB/s)\n";
+    cout << scheduler.workerCount() << " worker(s): " << long(summary.events / parallelSeconds) << " events/s ("
+         << long(megabytes / parallelSeconds) << " MB/s)\n";
+    cout << "Bulk update: " << summary.updated << " part-time employees in " << long(applySeconds * 1e3) << " ms\n";
+    cout << (correct ? "Hours match the generated shifts\n" : "HOURS DO NOT MATCH\n");
+    return correct ? 0 : 1;
+}
+
+struct LedgerExpectation {
+    unordered_map<uint64_t, pair<int, int64_t>> totals; // by ID raw: distinct projects, cents
+    size_t duplicates = 0;
+    size_t conflicts = 0;
+};
+
+// Writes a synthetic project ledger for the roster built by populateSynthetic:
+// rounds of one new project per employee, with earlier completions replayed,
+// some with a different amount, plus an unknown ID and a malformed line per round.
+LedgerExpectation writeProjectLedger(const string& path, size_t employees, size_t lines) {
+    LedgerExpectation expected;
+    FILE* file = fopen(path.c_str(), "wb");
+    if(!file) return expected;
+    auto amount = [](size_t i, size_t round) { return int64_t(1000 + mixBits(i << 20 | round) % 500000); };
+    auto append = [](string& out, size_t i, size_t round, int64_t cents) {
+        out += 'E'; out += to_string(i);
+        out += ",PRJ-"; out += to_string(round); out += ',';
+        out += to_string(cents / 100);
+        if(cents % 100) {
+            out += '.';
+            out += char('0' + cents % 100 / 10);
+            out += char('0' + cents % 10);
+        }
+        out += '\n';
+    };
+    string out;
+    size_t written = 0;
+    for(size_t round = 0; written < lines; round++) {
+        for(size_t k = 0; k < employees && written < lines; k++) {
+            size_t i = (k * 104729) % employees;
+            int64_t cents = amount(i, round);
+            append(out, i, round, cents);
+            auto& totals = expected.totals[EmployeeId("E" + to_string(i)).raw()];
+            totals.first++;
+            totals.second += cents;
+            written++;
+            uint64_t h = mixBits(i ^ round << 40);
+            if(round > 0 && h % 8 < 2 && written < lines) {
+                int64_t replayed = amount(i, round - 1) + int64_t(h % 8); // the second replay conflicts
+                append(out, i, round - 1, replayed);
+                (h % 8 == 0 ? expected.duplicates : expected.conflicts)++;
+                written++;
+            }
+        }
+        out += "X99999999,PRJ-0,5.00\nE1,PRJ-0,12.345\n";
+        if(round > 0) expected.duplicates++;
+        if(out.size() > (1 << 20) || written >= lines) {
+            fwrite(out.data(), 1, out.size(), file);
+            out.clear();
+        }
+    }
+    fclose(file);
+    auto& unknown = expected.totals[EmployeeId("X99999999").raw()];
+    unknown.first = 1;
+    unknown.second = 500;
+    return expected;
+}
+
+int benchProjectLedger(size_t lines) {
+    const size_t employees = 100000;
+    const size_t smallBudget = size_t(8) << 20;
+    string path = "/tmp/payroll_ledger_bench.csv";
+    LedgerExpectation expected = writeProjectLedger(path, employees, lines);
+    if(expected.totals.empty()) {
+        cout << "Cannot write " << path << "\n";
+        return 1;
+    }
+
+    PayrollSystem payroll;
+    populateSynthetic(payroll, employees);
+
+    ProjectLedger inMemory;
+    auto start = chrono::steady_clock::now();
+    bool read = inMemory.ingestFile(path);
+    double inMemorySeconds = secondsSince(start);
+    ProjectLedger bounded(smallBudget);
+    start = chrono::steady_clock::now();
+    read = bounded.ingestFile(path) && read;
+    double boundedSeconds = secondsSince(start);
+    remove(path.c_str());
+    start = chrono::steady_clock::now();
+    ProjectLedger::Summary summary = payroll.applyLedger(bounded);
+    double applySeconds = secondsSince(start);
+    ProjectLedger::Summary again = payroll.applyLedger(inMemory);
+
+    bool correct = read;
+    for(const ProjectLedger* ledger : { &inMemory, &bounded }) {
+        ProjectLedger::Summary result = ledger->result();
+        correct = correct && result.duplicates == expected.duplicates && result.conflicts == expected.conflicts
+               && result.contractors == expected.totals.size();
+        ledger->forEachContractor([&](const EmployeeId& id, int projects, int64_t cents) {
+            auto found = expected.totals.find(id.raw());
+            if(found == expected.totals.end() || found->second != make_pair(projects, cents)) correct = false;
+        });
+    }
+    for(size_t i = 2; i < employees; i += 3) {
+        const auto* emp = static_cast<const ContractualEmployee*>(payroll.findEmployee("E" + to_string(i)));
+        const auto& totals = expected.totals[EmployeeId("E" + to_string(i)).raw()];
+        if(totals.first == 0) continue;
+        if(!emp || emp->getProjectsCompleted() != totals.first || fabs(emp->getSalary() - totals.second / 100.0) > 0.01) {
+            correct = false;
+        }
+    }
+    correct = correct && summary.notOnRoster == 1 && summary.malformed > 0 && again.updated == 0
+           && bounded.result().largestPartition <= smallBudget;
+
+    ProjectLedger::Summary result = bounded.result();
+    double megabytes = result.bytes / 1e6;
+    cout << "Ledger: " << result.lines << " lines, " << long(megabytes) << " MB, " << result.completions << " completions for "
+         << result.contractors << " IDs (" << result.duplicates << " duplicates, " << result.conflicts << " conflicts, "
+         << result.malformed << " malformed)\n";
+    cout << "Unbounded: " << long(result.lines / inMemorySeconds) << " lines/s (" << long(megabytes / inMemorySeconds)
+         << " MB/s), " << inMemory.result().partitions << " partition(s)\n";
+    cout << (smallBudget >> 20) << " MB budget: " << long(result.lines / boundedSeconds) << " lines/s ("
+         << long(megabytes / boundedSeconds) << " MB/s), " << result.partitions << " partitions, largest "
+         << result.largestPartition / 1000 << " KB\n";
+    cout << "Bulk update: " << summary.updated << " contractual employees in " << long(applySeconds * 1e3)
+         << " ms, reapplied: " << again.updated << " changed\n";
+    cout << (correct ? "Ledger totals match the generated completions\n" : "LEDGER TOTALS DO NOT MATCH\n");
+    return correct ? 0 : 1;
+}
+
+// Writes a synthetic account feed keyed by employee ID in its second column,
+// about a tenth of it for IDs not on the roster built by populateSynthetic,
+// and returns the roster index of each row (employees for the others).
+vector<uint32_t> writeAccountFeed(const string& path, size_t employees, size_t rows) {
+    vector<uint32_t> keys;
+    FILE* file = fopen(path.c_str(), "wb");
+    if(!file) return keys;
+    keys.reserve(rows);
+    string out;
+    for(size_t r = 0; r < rows; r++) {
+        uint64_t h = mixBits(r);
+        size_t i = h % (employees + employees / 9);
+        out += "ACCT"; out += to_string(r);
+        out += ",E"; out += to_string(i);
+        out += ",BANK"; out += to_string(h >> 56); out += '\n';
+        keys.push_back(static_cast<uint32_t>(min(i, employees)));
+        if(out.size() > (1 << 20)) {
+            fwrite(out.data(), 1, out.size(), file);
+            out.clear();
+        }
+    }
+    fwrite(out.data(), 1, out.size(), file);
+    fclose(file);
+    return keys;
+}
+
+int benchJoin(size_t rows) {
+    const size_t employees = 1000000;
+    string path = "/tmp/payroll_join_bench.csv";
+    string matchedPath = "/tmp/payroll_join_matched.csv";
+    string unmatchedPath = "/tmp/payroll_join_unmatched.csv";
+    vector<uint32_t> keys = writeAccountFeed(path, employees, rows);
+    if(keys.size() != rows) {
+        cout << "Cannot write " << path << "\n";
+        return 1;
+    }
+    PayrollSystem payroll;
+    populateSynthetic(payroll, employees);
+    shared_ptr<const RosterSnapshot> roster = payroll.snapshot();
+    TaskScheduler scheduler(0);
+    payroll.useScheduler(&scheduler);
+
+    // Baseline: one lookup per row in the roster's own ID map.
+    size_t baselineMatched = 0;
+    size_t bytes = 0;
+    auto start = chrono::steady_clock::now();
+    forEachLineChunk(path, 8 << 20, bytes, [&](const char* begin, const char* end) {
+        EmployeeId id;
+        while(begin < end) {
+            const char* lineEnd = static_cast<const char*>(memchr(begin, '\n', end - begin));
+            if(!lineEnd) lineEnd = end;
+            const char* key = static_cast<const char*>(memchr(begin, ',', lineEnd - begin)) + 1;
+            const char* keyEnd = static_cast<const char*>(memchr(key, ',', lineEnd - key));
+            if(EmployeeId::lookup(string_view(key, keyEnd - key), id) && roster->find(id)) baselineMatched++;
+            begin = lineEnd + 1;
+        }
+    });
+    double baselineSeconds = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    RosterJoin serial(roster, nullptr, ',', 1);
+    double serialBuildSeconds = secondsSince(start);
+    start = chrono::steady_clock::now();
+    bool joined = serial.joinFile(path, nullptr, nullptr);
+    double serialSeconds = secondsSince(start);
+
+    RosterJoin::Summary summary;
+    start = chrono::steady_clock::now();
+    joined = payroll.joinFeed(path, ',', 1, matchedPath, unmatchedPath, summary) && joined;
+    double parallelSeconds = secondsSince(start); // includes the build
+    remove(path.c_str());
+
+    // Both outputs must keep input order, and matched rows must carry their employee.
+    bool correct = joined && summary.matched == baselineMatched && summary.matched == serial.result().matched
+                && summary.rows == rows && summary.unkeyed == 0;
+    size_t next = 0;
+    auto skipTo = [&](bool matched) {
+        while(next < rows && (keys[next] < employees) != matched) next++;
+        return next < rows ? keys[next++] : employees;
+    };
+    bytes = 0;
+    forEachLineChunk(matchedPath, 8 << 20, bytes, [&](const char* begin, const char* end) {
+        while(begin < end && correct) {
+            const char* lineEnd = static_cast<const char*>(memchr(begin, '\n', end - begin));
+            string_view line(begin, lineEnd - begin);
+            begin = lineEnd + 1;
+            size_t i = skipTo(true);
+            size_t name = line.find(',', line.find(',', line.find(',') + 1) + 1) + 1;
+            correct = i < employees && line.substr(name, line.find(',', name) - name) == syntheticName(i)
+                   && line.find(",E" + to_string(i) + ",") != string_view::npos;
+        }
+    });
+    correct = correct && skipTo(true) == employees;
+    next = 0;
+    bytes = 0;
+    forEachLineChunk(unmatchedPath, 8 << 20, bytes, [&](const char* begin, const char* end) {
+        while(begin < end && correct) {
+            const char* lineEnd = static_cast<const char*>(memchr(begin, '\n', end - begin));
+            string_view line(begin, lineEnd - begin);
+            begin = lineEnd + 1;
+            while(next < rows && keys[next] < employees) next++;
+            correct = next < rows && line.find(",BANK") != string_view::npos && line.substr(0, 4) == "ACCT"
+                   && line.substr(4, line.find(',') - 4) == to_string(next);
+            next++;
+        }
+    });
+    remove(matchedPath.c_str());
+    remove(unmatchedPath.c_str());
+
+    double megabytes = summary.bytes / 1e6;
+    cout << "Feed: " << summary.rows << " rows, " << long(megabytes) << " MB against " << employees << " employees ("
+         << summary.matched << " matched, " << summary.unmatched << " unmatched)\n";
+    cout << "Row-by-row lookups (count only): " << long(rows / baselineSeconds) << " rows/s\n";
+    cout << "Radix join, serial: build " << long(serialBuildSeconds * 1e3) << " ms, " << long(rows / serialSeconds)
+         << " rows/s (" << long(megabytes / serialSeconds) << " MB/s) without output\n";
+    cout << scheduler.workerCount() << " worker(s) with output: " << long(rows / parallelSeconds) << " rows/s ("
+         << long(megabytes / parallelSeconds) << " MB/s)\n";
+    cout << (correct ? "Joined rows match the feed\n" : "JOINED ROWS DO NOT MATCH\n");
+    return correct ? 0 : 1;
+}
+
+string readWholeFile(const string& path) {
+    string text;
+    FILE* file = fopen(path.c_str(), "rb");
+    if(!file) return text;
+    char buffer[1 << 16];
+    for(size_t read; (read = fread(buffer, 1, sizeof(buffer), file)) > 0;) text.append(buffer, read);
+    fclose(file);
+    return text;
+}
+
+bool writeWholeFile(const string& path, const string& text) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if(!file) return false;
+    bool written = fwrite(text.data(), 1, text.size(), file) == text.size();
+    return fclose(file) == 0 && written;
+}
+
+int benchRosterDiff(size_t count) {
+    const size_t budget = max(count * 8, size_t(1) << 20); // small enough to force several sorted runs
+    const string before = "/tmp/payroll_roster_before.csv", after = "/tmp/payroll_roster_after.csv";
+    const string shuffled = "/tmp/payroll_roster_shuffled.csv", changesPath = "/tmp/payroll_roster_changes.txt";
+    const string sortedChangesPath = "/tmp/payroll_roster_changes_sorted.txt", mergedPath = "/tmp/payroll_roster_merged.csv";
+    const string regions[3] = { "/tmp/payroll_roster_region0.csv", "/tmp/payroll_roster_region1.csv",
+                                "/tmp/payroll_roster_region2.csv" };
+    TaskScheduler scheduler(0);
+
+    // Last month's roster, and this month's after removals, raises and hires.
+    PayrollSystem lastMonth, thisMonth;
+    lastMonth.useScheduler(&scheduler);
+    thisMonth.useScheduler(&scheduler);
+    populateSynthetic(lastMonth, count);
+    populateSynthetic(thisMonth, count);
+    lastMonth.keepHistory(1);
+    auto start = chrono::steady_clock::now();
+    bool correct = lastMonth.saveRoster(before);
+    double saveSeconds = secondsSince(start);
+    for(size_t i = 0; i < count; i++) {
+        string id = "E" + to_string(i);
+        if(i % 50 == 0) thisMonth.removeEmployee(id);
+        else if(i % 3 == 0 && i % 70 == 3) thisMonth.updateMonthlySalary(id, 2500.25 + i % 1000);
+        else if(i % 3 == 1 && i % 60 == 1) thisMonth.updateHoursWorked(id, int(i % 170));
+    }
+    PayrollBatch hires;
+    for(size_t i = 0; i < count / 50; i++) hires.stage<PartTimeEmployee>("N" + to_string(i), syntheticName(count + i), 18.5, 80);
+    thisMonth.commitBatch(hires);
+    correct = thisMonth.saveRoster(after) && correct;
+
+    // Renames and type changes go straight into the file; the saved order is kept.
+    string expected, text = readWholeFile(after);
+    size_t renamedLines = 0;
+    vector<string_view> lines;
+    for(size_t at = 0, next; at < text.size(); at = next + 1) {
+        next = text.find('\n', at);
+        string_view line(&text[at], next - at);
+        uint64_t h = mixBits(at);
+        if(h % 97 == 0) {
+            expected.append(line.data(), line.size());
+            expected += " Jr";
+            renamedLines++;
+        } else if(h % 89 == 0 && line.find(",F,") != string_view::npos) {
+            size_t type = line.find(",F,");
+            size_t quantity = line.find(",0,", type + 2);
+            expected.append(line.data(), type); expected += ",C,";
+            expected.append(line.data() + type + 3, quantity - type - 3); expected += ",3,";
+            expected.append(line.data() + quantity + 3, line.size() - quantity - 3);
+        } else {
+            expected.append(line.data(), line.size());
+        }
+        expected += '\n';
+    }
+    correct = writeWholeFile(after, expected) && correct;
+    for(size_t at = 0, next; at < expected.size(); at = next + 1) {
+        next = expected.find('\n', at);
+        lines.push_back(string_view(&expected[at], next - at + 1));
+    }
+    for(size_t i = lines.size(); i > 1; i--) swap(lines[i - 1], lines[mixBits(i) % i]);
+    string region[3], unsorted;
+    size_t duplicates = 0, conflicts = 0;
+    for(size_t i = 0; i < lines.size(); i++) {
+        unsorted += lines[i];
+        uint64_t h = mixBits(i + 1);
+        size_t r = h % 3;
+        region[r] += lines[i];
+        if(h % 10 == 3) {
+            region[(r + 1) % 3] += lines[i]; // the same record from a second region
+            duplicates++;
+        } else if(h % 25 == 4 && r < 2) {
+            region[2] += lines[i].substr(0, lines[i].size() - 1); // a later, stale copy
+            region[2] += " (old)\n";
+            conflicts++;
+        }
+    }
+    correct = writeWholeFile(shuffled, unsorted) && correct;
+    for(int r = 0; r < 3; r++) correct = writeWholeFile(regions[r], region[r]) && correct;
+    text = string();
+    unsorted = string();
+
+    RosterDiff diff, sortedDiff;
+    FILE* changes = fopen(changesPath.c_str(), "wb");
+    start = chrono::steady_clock::now();
+    correct = changes && diffRosterFiles(before, shuffled, changes, diff, budget, &scheduler) && correct;
+    double diffSeconds = secondsSince(start);
+    if(changes) fclose(changes);
+    changes = fopen(sortedChangesPath.c_str(), "wb");
+    start = chrono::steady_clock::now();
+    correct = changes && diffRosterFiles(before, after, changes, sortedDiff, budget, &scheduler) && correct;
+    double sortedDiffSeconds = secondsSince(start);
+    if(changes) fclose(changes);
+    string changeSet = readWholeFile(changesPath);
+    correct = correct && changeSet == readWholeFile(sortedChangesPath) && diff.after.runs > 1 && sortedDiff.after.runs == 0
+           && diff.removed == (count + 49) / 50 && diff.added == count / 50 && diff.renamed > 0 && diff.payChanges > 0;
+
+    // Applying the change set to last month's roster must give this month's file, and undo must restore it.
+    PayrollSystem::RosterChanges applied;
+    start = chrono::steady_clock::now();
+    correct = lastMonth.applyRosterChanges(changesPath, applied) && correct;
+    double applySeconds = secondsSince(start);
+    correct = lastMonth.saveRoster(mergedPath) && readWholeFile(mergedPath) == expected && correct;
+    correct = applied.rejected == 0 && applied.malformed == 0 && lastMonth.undo() && correct;
+    correct = lastMonth.saveRoster(mergedPath) && readWholeFile(mergedPath) == readWholeFile(before) && correct;
+    // Undo and redo of renames must move the name indexes along with the rows.
+    correct = lastMonth.findByNamePrefix("jr").empty() && lastMonth.redo()
+           && lastMonth.findByNamePrefix("jr").size() == renamedLines && lastMonth.undo()
+           && lastMonth.findByNamePrefix("jr").empty() && correct;
+    for(const auto& match : lastMonth.findByFuzzyName("Jr", 20)) correct = correct && match.distance > 0;
+
+    RosterMerge merge;
+    FILE* merged = fopen(mergedPath.c_str(), "wb");
+    start = chrono::steady_clock::now();
+    correct = merged && mergeRosterFiles({ regions[0], regions[1], regions[2] }, merged, merge, budget, &scheduler) && correct;
+    double mergeSeconds = secondsSince(start);
+    if(merged) fclose(merged);
+    correct = correct && readWholeFile(mergedPath) == expected && merge.duplicates == duplicates && merge.conflicts == conflicts;
+
+    for(const string& path : { before, after, shuffled, changesPath, sortedChangesPath, mergedPath, regions[0], regions[1], regions[2] }) {
+        remove(path.c_str());
+    }
+    size_t rows = count + count / 50;
+    cout << "Rosters: " << count << " and " << lines.size() << " employees, " << expected.size() / 1000000 << " MB; "
+         << scheduler.workerCount() << " worker(s), " << (budget >> 20) << " MB sort budget\n";
+    cout << "Save sorted by ID: " << long(count / saveSeconds) << " employees/s\n";
+    cout << "Diff, already sorted: " << long(rows / sortedDiffSeconds) << " employees/s\n";
+    cout << "Diff, shuffled (" << diff.after.runs << " sorted runs): " << long(rows / diffSeconds) << " employees/s\n";
+    cout << "Change set: " << diff.added << " added, " << diff.removed << " removed, " << diff.payChanges << " pay changes, "
+         << diff.renamed << " renamed; " << changeSet.size() / 1000 << " KB\n";
+    cout << "Applied in " << long(applySeconds * 1e3) << " ms (one undo step)\n";
+    cout << "Merge of 3 shuffled regions: " << long(rows / mergeSeconds) << " employees/s (" << merge.duplicates
+         << " duplicates, " << merge.conflicts << " conflicts)\n";
+    cout << (correct ? "Diffs and merges reproduce the rosters\n" : "ROSTERS DO NOT MATCH\n");
+    return correct ? 0 : 1;
+}
+
+// Benchmark mode: A_E --bench <name> [count]
+int runBenchmark(const string& name, size_t count) {
+    if(name == "intern") return benchInterning(count ? count : 1000000);
+    if(name == "sort") return benchSorting(count ? count : 2000000);
+    if(name == "range") return benchRangeQueries(count ? count : 1000000);
+    if(name == "bitmap") return benchTypeBitmaps(count ? count : 2000000);
+    if(name == "prefix") return benchPrefixSearch(count ? count : 1000000);
+    if(name == "fuzzy") return benchFuzzySearch(count ? count : 1000000);
+    if(name == "churn") return benchChurn(count ? count : 1000000);
+    if(name == "snapshot") return benchSnapshots(count ? count : 200000);
+    if(name == "shards") return benchShardedInserts(count ? count : 200000);
+    if(name == "idset") return benchIdClaims(count ? count : 1000000);
+    if(name == "scheduler") return benchScheduler(count ? count : 1000000);
+    if(name == "totals") return benchDeterministicTotals(count ? count : 1000000);
+    if(name == "batch") return benchBatchCommits(count ? count : 1000000);
+    if(name == "history") return benchUndoRedo(count ? count : 200000);
+    if(name == "scenarios") return benchScenarios(count ? count : 1000000);
+    if(name == "projection") return benchProjection(count ? count : 200000);
+    if(name == "payruns") return benchPayRuns(count ? count : 200000);
+    if(name == "timesheets") return benchTimesheets(count ? count : 10000000);
+    if(name == "ledger") return benchProjectLedger(count ? count : 5000000);
+    if(name == "join") return benchJoin(count ? count : 10000000);
+    if(name == "rosterdiff") return benchRosterDiff(count ? count : 1000000);
+    cout << "Unknown benchmark: " << name << "\n";
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    if(argc > 1 && string(argv[1]) == "--alloc-check") {
+        return runAllocationCheck();
+    }
+    if(argc > 2 && string(argv[1]) == "--bench") {
+        return runBenchmark(argv[2], argc > 3 ? strtoull(argv[3], nullptr, 10) : 0);
+    }
+
+    // A_E [--workers <n>] [--pin-workers]
+    size_t workers = 0;
+    bool pinWorkers = false;
+    for(int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if(arg == "--workers" && i + 1 < argc) workers = strtoull(argv[++i], nullptr, 10);
+        else if(arg == "--pin-workers") pinWorkers = true;
+    }
+    TaskScheduler scheduler(workers, pinWorkers);
     PayrollSystem payroll;
+    payroll.useScheduler(&scheduler);
+    payroll.keepHistory(4096);
     bool running = true;
 
     while(running) {
@@ -276,24 +7070,61 @@ int main() {
         cout << "2. Add Part-time Employee\n";
         cout << "3. Add Contractual Employee\n";
         cout << "4. Generate Report\n";
-        cout << "5. Exit\n";
+        cout << "5. Sorted Report\n";
+        cout << "6. Report by Employment Type\n";
+        cout << "7. Salary Range Search\n";
+        cout << "8. Search by Name\n";
+        cout << "9. Fuzzy Name Search\n";
+        cout << "10. Update Employee\n";
+        cout << "11. Remove Employee\n";
+        cout << "12. Memory Statistics\n";
+        cout << "13. Scheduler Statistics\n";
+        cout << "14. Undo Last Change\n";
+        cout << "15. Redo\n";
+        cout << "16. What-if Raise Scenario\n";
+        cout << "17. Budget Projection\n";
+        cout << "18. Pay Runs\n";
+        cout << "19. Import Timesheet Events\n";
+        cout << "20. Import Project Ledger\n";
+        cout << "21. Join External File\n";
+        cout << "22. Roster Files\n";
+        cout << "23. Exit\n";
 
         string choice;
         cout << "Selection: ";
         getline(cin, choice);
-        choice = payroll.trim(choice);
+        payroll.trimInPlace(choice);
 
-        if(choice.length() != 1 || !isdigit(choice[0])) {
+        if(choice.empty() || choice.length() > 2 || !isdigit(choice[0]) ||
+           (choice.length() == 2 && !isdigit(choice[1]))) {
             cout << "Invalid menu choice!\n";
             continue;
         }
 
-        switch(choice[0]) {
-            case '1': payroll.addEmployee(1); break;
-            case '2': payroll.addEmployee(2); break;
-            case '3': payroll.addEmployee(3); break;
-            case '4': payroll.displayPayrollReport(); break;
-            case '5':
+        switch(stoi(choice)) {
+            case 1: payroll.addEmployee(1); break;
+            case 2: payroll.addEmployee(2); break;
+            case 3: payroll.addEmployee(3); break;
+            case 4: payroll.displayPayrollReport(); break;
+            case 5: payroll.displaySortedReport(); break;
+            case 6: payroll.displayTypeReport(); break;
+            case 7: payroll.displaySalaryRange(); break;
+            case 8: payroll.displayNameSearch(); break;
+            case 9: payroll.displayFuzzySearch(); break;
+            case 10: payroll.displayUpdateEmployee(); break;
+            case 11: payroll.displayRemoveEmployee(); break;
+            case 12: payroll.displayMemoryStats(); break;
+            case 13: scheduler.displayStats(); break;
+            case 14: payroll.displayUndo(); break;
+            case 15: payroll.displayRedo(); break;
+            case 16: payroll.displayScenario(); break;
+            case 17: payroll.displayProjection(); break;
+            case 18: payroll.displayPayRuns(); break;
+            case 19: payroll.displayTimesheetImport(); break;
+            case 20: payroll.displayLedgerImport(); break;
+            case 21: payroll.displayJoin(); break;
+            case 22: payroll.displayRosterFiles(); break;
+            case 23:
                 cout << "Exiting system...\n";
                 running = false;
                 break;
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <string>
+#include <utility>
 
 using namespace std;
 
@@ -11,14 +12,14 @@ private:
     double salary;     // Encapsulated data
 
 protected:
-    Employee(string empName, int empAge, double empSalary) : name(empName), age(empAge), salary(empSalary) {}
+    Employee(string empName, int empAge, double empSalary) : name(std::move(empName)), age(empAge), salary(empSalary) {}
 
 public:
     // Pure virtual function (abstraction)
     virtual void calculateBonus() = 0;
 
     // Getters (encapsulation: controlled access)
-    string getName() const {
+    const string& getName() const {
         return name;
     }
 
@@ -41,7 +42,7 @@ public:
 // Derived class for Permanent Employee
 class PermanentEmployee : public Employee {
 public:
-    PermanentEmployee(string name, int age, double salary) : Employee(name, age, salary) {}
+    PermanentEmployee(string name, int age, double salary) : Employee(std::move(name), age, salary) {}
 
     void calculateBonus() override {
         double bonus = getSalary() * 0.1; // 10% of salary as bonus
@@ -52,7 +53,7 @@ public:
 // Derived class for Contract Employee
 class ContractEmployee : public Employee {
 public:
-    ContractEmployee(string name, int age, double salary) : Employee(name, age, salary) {}
+    ContractEmployee(string name, int age, double salary) : Employee(std::move(name), age, salary) {}
 
     void calculateBonus() override {
         double bonus = getSalary() * 0.05; // 5% of salary as bonus
@@ -62,7 +63,7 @@ public:
 
 class InternEmployee : public Employee {
     
-}
+};
 
 int main() {
     PermanentEmployee emp1("John Doe", 30, 50000);